@@ -4,6 +4,8 @@ layout (location = 0) in vec3 vPosition;
 layout (location = 1) in vec3 vNormal;
 layout (location = 2) in vec3 vColor;
 
+layout (location = 3) in mat4 vInstanceTransform;
+
 layout (location = 0) out vec3 outColor;
 
 
@@ -14,16 +16,9 @@ layout(set = 0, binding = 0) uniform CameraBufferUniform
 	mat4 myViewProjection;
 } CameraData;
 
-
-layout( push_constant ) uniform Constants
-{
-	vec4 myData;
-	mat4 myRenderMatrix;
-} PushConstants;
-
 void main()
 {
-	mat4 transformMatrix = (CameraData.myViewProjection * PushConstants.myRenderMatrix);
+	mat4 transformMatrix = (CameraData.myViewProjection * vInstanceTransform);
 	gl_Position = transformMatrix * vec4(vPosition, 1.0f);
 	outColor = vColor;
-}
\ No newline at end of file
+}
@@ -0,0 +1,40 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (location = 0) out vec4 outFragColor;
+layout (location = 0) in vec3 inColor;
+
+layout(set = 0, binding = 1) uniform SceneDataUniform
+{
+	vec4 myFogColor; // w is for exponent
+	vec4 myFogDistances; //x for min, y for max, zw unused.
+	vec4 myAmbientColor;
+	vec4 mySunlightDirection; //w for sun power
+	vec4 mySunlightColor;
+} SceneData;
+
+// Mirrors GPUMaterialData
+struct MaterialData
+{
+	vec4 myBaseColor;
+};
+
+// The bindless table, every storage buffer registered with it at its handle
+layout(set = 1, binding = 0) readonly buffer MaterialBuffer
+{
+	MaterialData myMaterials[];
+} Buffers[];
+
+// Mirrors BindlessPushConstants
+layout(push_constant) uniform DrawConstants
+{
+	uint myMaterialBuffer;
+	uint myMaterialIndex;
+} Draw;
+
+void main()
+{
+	// Same for the whole draw, so no nonuniformEXT needed
+	MaterialData material = Buffers[Draw.myMaterialBuffer].myMaterials[Draw.myMaterialIndex];
+	outFragColor = vec4(inColor * material.myBaseColor.rgb + SceneData.myAmbientColor.xyz, material.myBaseColor.a);
+}
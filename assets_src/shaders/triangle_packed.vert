@@ -0,0 +1,26 @@
+#version 450
+
+// Packed vertex layout, 16 bytes instead of 36
+layout (location = 0) in vec4 vPosition; // UNORM16, [0, 1] inside the mesh bounds
+layout (location = 1) in vec2 vNormal;   // SNORM16, octahedral encoded
+layout (location = 2) in vec4 vColor;    // UNORM8
+
+// Includes the mesh's dequantization, so the [0, 1] positions can be used as they are
+layout (location = 3) in mat4 vInstanceTransform;
+
+layout (location = 0) out vec3 outColor;
+
+
+layout(set = 0, binding = 0) uniform CameraBufferUniform
+{
+	mat4 myView;
+	mat4 myProjection;
+	mat4 myViewProjection;
+} CameraData;
+
+void main()
+{
+	mat4 transformMatrix = (CameraData.myViewProjection * vInstanceTransform);
+	gl_Position = transformMatrix * vec4(vPosition.xyz, 1.0f);
+	outColor = vColor.rgb;
+}
@@ -0,0 +1,58 @@
+#include "odyssey/core/logger.h"
+#include "renderer/frustum_culling.h"
+
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+// Culls a million spheres scattered around the camera, roughly a tenth of them end up visible.
+// Compares the SIMD path the build was compiled with against the scalar one.
+
+constexpr u32 OBJECT_COUNT = 1000000;
+constexpr int ITERATIONS = 20;
+
+template<class Function>
+static void Measure(const char* name, Function function)
+{
+	double best = 1e30;
+	double total = 0.0;
+	u32 visibleCount = 0;
+
+	for (int i = 0; i < ITERATIONS; ++i)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		visibleCount = function();
+		const auto end = std::chrono::high_resolution_clock::now();
+
+		const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+		best = std::min(best, ms);
+		total += ms;
+	}
+
+	Logger::Log("{:<8} best {:8.3f} ms  avg {:8.3f} ms  {:.1f} Mobjects/s  visible {}", name, best, total / ITERATIONS, OBJECT_COUNT / best / 1000.0, visibleCount);
+}
+
+int main()
+{
+	Mat4 projection = glm::perspective(glm::radians(70.f), 1700.f / 900.f, 0.1f, 200.0f);
+	projection[1][1] *= -1;
+	const Mat4 view = glm::lookAt(Vec3(0.0f), Vec3(0.0f, 0.0f, -1.0f), Vec3(0.0f, 1.0f, 0.0f));
+	const Frustum frustum = FrustumCulling::ExtractFrustum(projection * view);
+
+	std::mt19937 random(1337);
+	std::uniform_real_distribution<float> position(-250.0f, 250.0f);
+	std::uniform_real_distribution<float> radius(0.5f, 4.0f);
+
+	BoundingSphereSoA spheres{};
+	spheres.Resize(OBJECT_COUNT);
+	for (u32 i = 0; i < OBJECT_COUNT; ++i)
+		spheres.Set(i, Vec3(position(random), position(random), position(random)), radius(random));
+
+	Vector<u32> visible(OBJECT_COUNT);
+
+	Logger::Log("{} objects, {} iterations", OBJECT_COUNT, ITERATIONS);
+	Measure("SIMD", [&]() { return FrustumCulling::CullSpheres(frustum, spheres, visible.data()); });
+	Measure("Scalar", [&]() { return FrustumCulling::CullSpheresScalar(frustum, spheres, visible.data()); });
+
+	return 0;
+}
@@ -0,0 +1,85 @@
+#include "odyssey/core/job_system.h"
+#include "odyssey/core/logger.h"
+
+#include <chrono>
+#include <future>
+#include <thread>
+#include <algorithm>
+
+// Fan-out / fan-in graph: one root spawns JOB_COUNT leaf jobs, the root then waits for all of them
+// and reduces their results. Compares the job system against one std::async per leaf.
+
+constexpr u32 JOB_COUNT = 10000;
+constexpr u32 WORK_PER_JOB = 2000;
+constexpr int ITERATIONS = 10;
+
+static u64 DoWork(u32 seed)
+{
+	u64 value = seed;
+	for (u32 i = 0; i < WORK_PER_JOB; ++i)
+		value = value * 6364136223846793005ull + 1442695040888963407ull;
+	return value;
+}
+
+static u64 RunJobSystem(Vector<u64>& results)
+{
+	JobCounter counter{};
+	for (u32 i = 0; i < JOB_COUNT; ++i)
+		JobSystem::Run(counter, [&results, i]() { results[i] = DoWork(i); });
+	JobSystem::Wait(counter);
+
+	u64 sum = 0;
+	for (u64 result : results)
+		sum += result;
+	return sum;
+}
+
+static u64 RunAsync(Vector<u64>& results)
+{
+	Vector<std::future<void>> futures;
+	futures.reserve(JOB_COUNT);
+	for (u32 i = 0; i < JOB_COUNT; ++i)
+		futures.push_back(std::async(std::launch::async, [&results, i]() { results[i] = DoWork(i); }));
+	for (std::future<void>& future : futures)
+		future.wait();
+
+	u64 sum = 0;
+	for (u64 result : results)
+		sum += result;
+	return sum;
+}
+
+template<class Function>
+static void Measure(const char* name, Function function)
+{
+	Vector<u64> results(JOB_COUNT);
+	double best = 1e30;
+	double total = 0.0;
+	u64 checksum = 0;
+
+	for (int i = 0; i < ITERATIONS; ++i)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		checksum = function(results);
+		const auto end = std::chrono::high_resolution_clock::now();
+
+		const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+		best = std::min(best, ms);
+		total += ms;
+	}
+
+	Logger::Log("{:<12} best {:8.3f} ms  avg {:8.3f} ms  checksum {}", name, best, total / ITERATIONS, checksum);
+}
+
+int main()
+{
+	const int coreCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	JobSystem::Initialize(coreCount);
+
+	Logger::Log("{} jobs, {} iterations, {} threads", JOB_COUNT, ITERATIONS, JobSystem::GetThreadCount());
+	Measure("JobSystem", RunJobSystem);
+	Measure("std::async", RunAsync);
+
+	JobSystem::Shutdown();
+	return 0;
+}
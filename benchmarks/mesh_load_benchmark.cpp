@@ -0,0 +1,124 @@
+#include "odyssey/core/logger.h"
+#include "odyssey/platform/platform_layer.h"
+#include "renderer/cooked_mesh.h"
+#include "renderer/vulkan/vulkan_mesh.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// Compares getting a mesh ready for upload from the OBJ against the cooked blob. Both end with
+// the vertex and index streams copied into a buffer standing in for the mapped GPU buffer.
+// Uses the OBJ given on the command line, or a generated sphere when there is none.
+
+constexpr u32 SPHERE_RINGS = 256;
+constexpr u32 SPHERE_SEGMENTS = 512;
+constexpr int ITERATIONS = 5;
+
+static const char* GENERATED_OBJ = "mesh_load_benchmark.obj";
+static const char* COOKED_MESH = "mesh_load_benchmark.mesh";
+
+static void WriteSphereObj(const char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+		return;
+
+	const float pi = 3.14159265f;
+	for (u32 ring = 0; ring <= SPHERE_RINGS; ++ring)
+	{
+		const float theta = pi * ring / SPHERE_RINGS;
+		for (u32 segment = 0; segment < SPHERE_SEGMENTS; ++segment)
+		{
+			const float phi = 2.0f * pi * segment / SPHERE_SEGMENTS;
+			const Vec3 normal(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+			fprintf(file, "v %f %f %f\nvn %f %f %f\n", normal.x * 2.0f, normal.y * 2.0f, normal.z * 2.0f, normal.x, normal.y, normal.z);
+		}
+	}
+
+	for (u32 ring = 0; ring < SPHERE_RINGS; ++ring)
+	{
+		for (u32 segment = 0; segment < SPHERE_SEGMENTS; ++segment)
+		{
+			const u32 a = ring * SPHERE_SEGMENTS + segment + 1;
+			const u32 b = ring * SPHERE_SEGMENTS + (segment + 1) % SPHERE_SEGMENTS + 1;
+			const u32 c = a + SPHERE_SEGMENTS;
+			const u32 d = b + SPHERE_SEGMENTS;
+			fprintf(file, "f %u//%u %u//%u %u//%u\nf %u//%u %u//%u %u//%u\n", a, a, c, c, d, d, a, a, d, d, b, b);
+		}
+	}
+
+	fclose(file);
+}
+
+template<class Function>
+static double Time(Function function)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+	function();
+	const auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+	Logger::Initialize();
+
+	const bool isGenerated = argc < 2;
+	const char* objPath = isGenerated ? GENERATED_OBJ : argv[1];
+	if (isGenerated)
+		WriteSphereObj(objPath);
+
+	Mesh cookSource{};
+	if (!cookSource.LoadFromObj(objPath) || !cookSource.SaveCooked(COOKED_MESH))
+		return 1;
+
+	const size_t streamSize = cookSource.GetVertexDataSize() + cookSource.GetIndexDataSize();
+	Vector<u8> gpuBuffer(streamSize);
+
+	double objTime = 0.0;
+	double cookedTime = 0.0;
+
+	for (int i = 0; i < ITERATIONS; ++i)
+	{
+		objTime += Time([&]()
+		{
+			Mesh mesh{};
+			mesh.LoadFromObj(objPath);
+			memcpy(gpuBuffer.data(), mesh.GetVertexData(), mesh.GetVertexDataSize());
+			mesh.CopyIndexData(gpuBuffer.data() + mesh.GetVertexDataSize());
+		});
+
+		cookedTime += Time([&]()
+		{
+			MappedFile file{};
+			if (!PlatformLayer::MapFile(COOKED_MESH, file))
+				return;
+
+			if (CookedMesh::Validate(file.myData, file.mySize, COOKED_MESH))
+			{
+				const CookedMeshHeader& header = *reinterpret_cast<const CookedMeshHeader*>(file.myData);
+				Mesh mesh{};
+				mesh.SetFromCooked(header);
+				memcpy(gpuBuffer.data(), file.myData + header.myVertexOffset, header.myVertexSize);
+				memcpy(gpuBuffer.data() + header.myVertexSize, file.myData + header.myIndexOffset, header.myIndexSize);
+			}
+
+			PlatformLayer::UnmapFile(file);
+		});
+	}
+
+	objTime /= ITERATIONS;
+	cookedTime /= ITERATIONS;
+
+	Logger::Log("{} triangles, {:.2f} MB of vertex and index data", cookSource.myIndexCount / 3, streamSize / (1024.0 * 1024.0));
+	Logger::Log("OBJ    {:9.3f} ms", objTime);
+	Logger::Log("Cooked {:9.3f} ms  {:.1f}x faster", cookedTime, objTime / cookedTime);
+
+	std::remove(COOKED_MESH);
+	if (isGenerated)
+		std::remove(GENERATED_OBJ);
+
+	return 0;
+}
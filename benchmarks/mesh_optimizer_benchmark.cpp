@@ -0,0 +1,80 @@
+#include "odyssey/core/logger.h"
+#include "renderer/mesh_optimizer.h"
+
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+// Runs the mesh optimization passes on a grid with shuffled triangles and reports the simulated
+// post transform cache efficiency after every pass, together with how long each pass took.
+
+constexpr u32 GRID_SIZE = 512;
+
+static void Report(const char* name, const Vector<u32>& indices, u32 vertexCount, double ms)
+{
+	const VertexCacheStats stats = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+	Logger::Log("{:<14} ACMR {:.3f}  ATVR {:.3f}  {:8.3f} ms", name, stats.myACMR, stats.myATVR, ms);
+}
+
+template<class Function>
+static double Time(Function function)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+	function();
+	const auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main()
+{
+	Vector<Vec3> positions;
+	for (u32 y = 0; y <= GRID_SIZE; ++y)
+	{
+		for (u32 x = 0; x <= GRID_SIZE; ++x)
+			positions.push_back(Vec3(static_cast<float>(x), static_cast<float>(y), 0.0f));
+	}
+
+	Vector<u32> triangles;
+	for (u32 y = 0; y < GRID_SIZE; ++y)
+	{
+		for (u32 x = 0; x < GRID_SIZE; ++x)
+		{
+			const u32 a = y * (GRID_SIZE + 1) + x;
+			const u32 b = a + GRID_SIZE + 1;
+			triangles.insert(triangles.end(), { a, a + 1, b + 1, a, b + 1, b });
+		}
+	}
+
+	std::mt19937 random(1337);
+	Vector<u32> order(triangles.size() / 3);
+	for (u32 i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::shuffle(order.begin(), order.end(), random);
+
+	Vector<u32> indices;
+	indices.reserve(triangles.size());
+	for (u32 triangle : order)
+		indices.insert(indices.end(), { triangles[triangle * 3], triangles[triangle * 3 + 1], triangles[triangle * 3 + 2] });
+
+	const u32 vertexCount = static_cast<u32>(positions.size());
+	Logger::Log("{} triangles, {} vertices, cache size {}", indices.size() / 3, vertexCount, MeshOptimizer::DEFAULT_CACHE_SIZE);
+
+	Report("Shuffled", indices, vertexCount, 0.0);
+
+	Vector<u32> clusters;
+	double ms = Time([&]() { MeshOptimizer::OptimizeVertexCache(indices.data(), indices.data(), indices.size(), vertexCount, MeshOptimizer::DEFAULT_CACHE_SIZE, &clusters); });
+	Report("Vertex cache", indices, vertexCount, ms);
+
+	ms = Time([&]() { MeshOptimizer::OptimizeOverdraw(indices.data(), indices.size(), clusters, &positions[0].x, sizeof(Vec3)); });
+	Report("Overdraw", indices, vertexCount, ms);
+
+	Vector<u32> remap(vertexCount);
+	ms = Time([&]()
+	{
+		const u32 usedVertexCount = MeshOptimizer::BuildVertexFetchRemap(remap.data(), indices.data(), indices.size(), vertexCount);
+		MeshOptimizer::RemapVertices(positions, indices, remap, usedVertexCount);
+	});
+	Report("Vertex fetch", indices, vertexCount, ms);
+
+	return 0;
+}
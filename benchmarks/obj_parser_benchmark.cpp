@@ -0,0 +1,124 @@
+#include "odyssey/core/job_system.h"
+#include "odyssey/core/logger.h"
+#include "renderer/obj_parser.h"
+
+#include <tiny_obj_loader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+// Writes a height field with roughly the given number of triangles (10 million by default) as an
+// OBJ and reports how fast tinyobjloader and ObjParser read it, after checking they agree.
+// Usage: obj_parser_benchmark [triangle count]
+
+constexpr u32 DEFAULT_TRIANGLE_COUNT = 10000000;
+constexpr int ITERATIONS = 3;
+
+static const char* OBJ_PATH = "obj_parser_benchmark.obj";
+
+static size_t WriteHeightFieldObj(const char* path, u32 gridSize)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return 0;
+
+	const auto height = [](u32 x, u32 y) { return 0.25f * std::sin(x * 0.05f) * std::cos(y * 0.07f); };
+
+	for (u32 y = 0; y <= gridSize; ++y)
+	{
+		for (u32 x = 0; x <= gridSize; ++x)
+			fprintf(file, "v %.6f %.6f %.6f\n", x * 0.01f, height(x, y), y * 0.01f);
+	}
+
+	for (u32 y = 0; y <= gridSize; ++y)
+	{
+		for (u32 x = 0; x <= gridSize; ++x)
+		{
+			const Vec3 normal = glm::normalize(Vec3(height(x + 1, y) - height(x, y), 0.01f, height(x, y + 1) - height(x, y)));
+			fprintf(file, "vn %.6f %.6f %.6f\n", normal.x, normal.y, normal.z);
+		}
+	}
+
+	for (u32 y = 0; y < gridSize; ++y)
+	{
+		for (u32 x = 0; x < gridSize; ++x)
+		{
+			const u32 a = y * (gridSize + 1) + x + 1;
+			const u32 b = a + gridSize + 1;
+			fprintf(file, "f %u//%u %u//%u %u//%u\nf %u//%u %u//%u %u//%u\n", a, a, a + 1, a + 1, b + 1, b + 1, a, a, b + 1, b + 1, b, b);
+		}
+	}
+
+	const size_t size = static_cast<size_t>(ftell(file));
+	fclose(file);
+	return size;
+}
+
+template<class Function>
+static double Time(Function function)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+	function();
+	const auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static bool IsSame(const float* a, const float* b, size_t count)
+{
+	return std::memcmp(a, b, count * sizeof(float)) == 0;
+}
+
+int main(int argc, char* argv[])
+{
+	const int coreCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	JobSystem::Initialize(coreCount);
+
+	const u32 triangleCount = argc > 1 ? static_cast<u32>(std::strtoul(argv[1], nullptr, 10)) : DEFAULT_TRIANGLE_COUNT;
+	const u32 gridSize = std::max(1u, static_cast<u32>(std::ceil(std::sqrt(triangleCount / 2.0))));
+
+	const size_t fileSize = WriteHeightFieldObj(OBJ_PATH, gridSize);
+	const double megabytes = fileSize / (1024.0 * 1024.0);
+	Logger::Log("{} triangles, {:.1f} MB, {} threads", 2ull * gridSize * gridSize, megabytes, JobSystem::GetThreadCount());
+
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	const double tinyObjTime = Time([&]()
+	{
+		std::vector<tinyobj::material_t> materials;
+		std::string warn;
+		std::string err;
+		tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, OBJ_PATH, nullptr);
+	});
+	Logger::Log("tinyobjloader {:9.1f} ms  {:7.1f} MB/s", tinyObjTime, megabytes / (tinyObjTime / 1000.0));
+
+	ObjData data;
+	double best = 1e30;
+	for (int i = 0; i < ITERATIONS; ++i)
+		best = std::min(best, Time([&]() { ObjParser::ParseFile(OBJ_PATH, data); }));
+	Logger::Log("ObjParser     {:9.1f} ms  {:7.1f} MB/s  {:.1f}x", best, megabytes / (best / 1000.0), tinyObjTime / best);
+
+	bool isSame = !shapes.empty()
+		&& data.myPositions.size() * 3 == attrib.vertices.size() && IsSame(&data.myPositions[0].x, attrib.vertices.data(), attrib.vertices.size())
+		&& data.myNormals.size() * 3 == attrib.normals.size() && IsSame(&data.myNormals[0].x, attrib.normals.data(), attrib.normals.size())
+		&& data.myTriangleIndices.size() == shapes[0].mesh.indices.size();
+	for (size_t i = 0; isSame && i < data.myTriangleIndices.size(); ++i)
+	{
+		const tinyobj::index_t& index = shapes[0].mesh.indices[i];
+		isSame = data.myTriangleIndices[i].myPosition == index.vertex_index && data.myTriangleIndices[i].myNormal == index.normal_index;
+	}
+
+	if (isSame)
+		Logger::Log("Both parsers produced identical data");
+	else
+		Logger::LogError("The parsers disagree");
+
+	std::remove(OBJ_PATH);
+	JobSystem::Shutdown();
+
+	return isSame ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#include "odyssey/core/job_system.h"
+#include "odyssey/core/logger.h"
+#include "renderer/render_queue.h"
+
+#include <chrono>
+#include <random>
+#include <thread>
+#include <algorithm>
+
+// Sorts a frame worth of draw keys with few distinct pipelines and materials, like a real
+// scene would produce, and compares the render queue's radix sort against std::sort. The
+// radix sort has to come out the same as std::stable_sort, equal keys in push order.
+
+constexpr u32 DRAW_COUNT = 1000000;
+constexpr int ITERATIONS = 10;
+
+static void FillQueue(RenderQueue& queue, const Vector<u64>& keys)
+{
+	queue.Clear();
+	for (u32 i = 0; i < DRAW_COUNT; ++i)
+		queue.Push(keys[i], i);
+}
+
+template<class Function>
+static void Measure(const char* name, Function function)
+{
+	double best = 1e30;
+	double total = 0.0;
+
+	for (int i = 0; i < ITERATIONS; ++i)
+	{
+		const double ms = function();
+		best = std::min(best, ms);
+		total += ms;
+	}
+
+	Logger::Log("{:<12} best {:8.3f} ms  avg {:8.3f} ms", name, best, total / ITERATIONS);
+}
+
+int main()
+{
+	const int coreCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	JobSystem::Initialize(coreCount);
+
+	std::mt19937 random(1337);
+	Vector<u64> keys(DRAW_COUNT);
+	for (u64& key : keys)
+		key = RenderSortKey::Make(0, random() % 8, random() % 64, random() % 512, (random() % 10000) / 10000.0f);
+
+	Logger::Log("{} draws, {} iterations, {} threads", DRAW_COUNT, ITERATIONS, JobSystem::GetThreadCount());
+
+	RenderQueue queue{};
+	Measure("RenderQueue", [&]()
+	{
+		FillQueue(queue, keys);
+		const auto start = std::chrono::high_resolution_clock::now();
+		queue.Sort();
+		const auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	});
+
+	Vector<RenderQueueEntry> entries(DRAW_COUNT);
+	Measure("std::sort", [&]()
+	{
+		for (u32 i = 0; i < DRAW_COUNT; ++i)
+			entries[i] = { keys[i], i };
+		const auto start = std::chrono::high_resolution_clock::now();
+		std::sort(entries.begin(), entries.end(), [](const RenderQueueEntry& lhs, const RenderQueueEntry& rhs) { return lhs.myKey < rhs.myKey; });
+		const auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	});
+
+	FillQueue(queue, keys);
+	queue.Sort();
+	for (u32 i = 0; i < DRAW_COUNT; ++i)
+		entries[i] = { keys[i], i };
+	std::stable_sort(entries.begin(), entries.end(), [](const RenderQueueEntry& lhs, const RenderQueueEntry& rhs) { return lhs.myKey < rhs.myKey; });
+
+	const RenderQueueEntry* sorted = queue.GetEntries();
+	bool isSame = queue.GetCount() == DRAW_COUNT;
+	for (u32 i = 0; isSame && i < DRAW_COUNT; ++i)
+	{
+		isSame = sorted[i].myKey == entries[i].myKey && sorted[i].myIndex == entries[i].myIndex
+			&& (i == 0 || sorted[i - 1].myKey <= sorted[i].myKey);
+	}
+
+	if (isSame)
+		Logger::Log("RenderQueue matches std::stable_sort");
+	else
+		Logger::LogError("RenderQueue sorted differently from std::stable_sort");
+
+	JobSystem::Shutdown();
+	return isSame ? 0 : 1;
+}
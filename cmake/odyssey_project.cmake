@@ -102,7 +102,11 @@ function(odysseyProject name sources headers proj_resources genDefinitions targe
     SET(LINK_LIBRARIES ${LINK_LIBRARIES} imgui)
 	
 	if (USE_VULKAN)
-	    SET(LINK_LIBRARIES ${LINK_LIBRARIES} vulkan-1)
+	    if (${CMAKE_SYSTEM_NAME} MATCHES "Windows")
+	        SET(LINK_LIBRARIES ${LINK_LIBRARIES} vulkan-1)
+	    else()
+	        SET(LINK_LIBRARIES ${LINK_LIBRARIES} vulkan)
+	    endif()
 	    SET(LINK_LIBRARIES ${LINK_LIBRARIES} vkbootstrap)
 	endif()
 
@@ -119,6 +123,12 @@ function(odysseyProject name sources headers proj_resources genDefinitions targe
         add_definitions(-DIS_WINDOWS_PLATFORM=0)
     endif()
 
+    if (USE_PROFILER)
+        add_definitions(-DUSE_PROFILER=1)
+    else()
+        add_definitions(-DUSE_PROFILER=0)
+    endif()
+
     add_executable(${name} ${proj_sources} ${proj_headers} ${proj_resources})
     target_link_libraries(${name} ${LINK_LIBRARIES})
 endfunction(odysseyProject)
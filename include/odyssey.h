@@ -6,6 +6,10 @@
 #include "odyssey/core/engine.h"
 #include "odyssey/core/assert.h"
 #include "odyssey/core/logger.h"
+#include "odyssey/core/job_system.h"
+#include "odyssey/core/frame_pacer.h"
+#include "odyssey/core/frame_pipeline.h"
+#include "odyssey/core/profiler.h"
 
 // External
 //
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "odyssey/core/frame_pacer.h"
+#include "odyssey/core/frame_pipeline.h"
+
 class Game;
 
 class Engine
@@ -9,6 +12,16 @@ public:
 	~Engine();
 	void Run();
 
+	FramePacer& GetFramePacer() { return myFramePacer; }
+
+	// Renders on a dedicated thread one frame behind the simulation, set before Run
+	void SetPipelinedRendering(bool enabled) { myIsPipelined = enabled; }
+	FramePipelineStats GetFramePipelineStats() const { return myFramePipeline.GetStats(); }
+
 private:
 	Game* myGame{};
+	FramePacer myFramePacer{};
+	FramePipeline myFramePipeline{};
+	bool myIsPipelined{};
+	double mySimulationTime{};
 };
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "odyssey/types.h"
+
+struct FrameStats
+{
+	// All times are in milliseconds over the frames kept in the history
+	double myLastFrameTime{};
+	double myAverageFrameTime{};
+	double myMinFrameTime{};
+	double myMaxFrameTime{};
+	double myJitter{};
+	u64 myFrameCount{};
+	u64 mySimulationStepCount{};
+	u64 myDroppedSimulationSteps{};
+};
+
+// Paces frames towards a target frame rate and drives a fixed-timestep simulation.
+// Per frame: BeginFrame, StepSimulation until it returns false, render with GetInterpolation, EndFrame.
+class FramePacer
+{
+public:
+	static constexpr u32 HISTORY_SIZE = 240;
+
+	// 0 disables the cap and leaves pacing to the swapchain
+	void SetTargetFrameRate(double framesPerSecond);
+	double GetTargetFrameRate() const;
+
+	void SetFixedTimestep(double seconds);
+	float GetFixedTimestep() const;
+
+	void Start();
+	void BeginFrame();
+	bool StepSimulation();
+	void EndFrame();
+
+	// How far the render frame is between the last and the next simulation step, [0, 1)
+	float GetInterpolation() const;
+
+	const FrameStats& GetStats() const;
+	// Frame times in milliseconds, oldest first
+	void GetFrameTimeHistory(Vector<float>& outHistory) const;
+
+private:
+	void WaitUntil(u64 deadline);
+	void UpdateStats(u64 frameTime);
+
+	u64 myTargetFrameTime{};
+	u64 myFixedTimestep = 1000000000ull / 60;
+
+	u64 myLastFrameStart{};
+	u64 myNextDeadline{};
+	u64 myAccumulator{};
+	u32 myStepsThisFrame{};
+	bool myIsFirstFrame = true;
+
+	// Recent worst case duration of a 1 ms sleep, below this we spin instead
+	u64 mySleepOvershoot = 2000000;
+
+	float myFrameTimes[HISTORY_SIZE]{};
+	u32 myHistoryHead{};
+	u32 myHistoryCount{};
+
+	FrameStats myStats{};
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "odyssey/types.h"
+
+// Everything the renderer needs from the simulation for one frame. Written by the
+// main thread, read by the renderer, never touched by both at the same time.
+struct RenderSnapshot
+{
+	u64 myFrameIndex{};
+	double mySimulationTime{};
+	float myInterpolation{};
+	u64 mySubmitTime{};
+};
+
+struct FramePipelineStats
+{
+	// Milliseconds from a snapshot being submitted to the renderer being done with it
+	double myLastLatency{};
+	double myAverageLatency{};
+	double myMaxLatency{};
+	// Milliseconds the main thread was blocked waiting for the render thread
+	double myLastStall{};
+	u64 myRenderedFrameCount{};
+	u64 myLastRenderedFrameIndex{};
+};
+
+// Runs the renderer on its own thread one frame behind the simulation. Snapshots are
+// double buffered so the simulation of frame N + 1 overlaps with rendering of frame N.
+class FramePipeline
+{
+public:
+	void Start();
+	void Stop();
+	bool IsRunning() const { return myIsRunning; }
+
+	RenderSnapshot& GetWriteSnapshot();
+	// Hands the write snapshot to the render thread. Blocks while the render thread is still
+	// using the other buffer, which bounds the latency to one extra frame.
+	void Submit();
+
+	FramePipelineStats GetStats() const;
+
+private:
+	void RenderThreadLoop();
+
+	RenderSnapshot mySnapshots[2]{};
+	u32 myWriteIndex{};
+	u32 myPendingIndex{};
+	u32 myRenderingIndex{};
+	bool myHasPending{};
+	bool myIsRendering{};
+	bool myIsRunning{};
+
+	FramePipelineStats myStats{};
+
+	std::thread myRenderThread{};
+	mutable std::mutex myMutex{};
+	std::condition_variable myCondition{};
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+#include "odyssey/types.h"
+
+// Counts the jobs that still have to finish. A counter can be shared by any number of jobs
+// and be waited on to express dependencies between groups of jobs (fan-out / fan-in).
+struct JobCounter
+{
+	std::atomic<i32> myValue{};
+
+	bool IsDone() const
+	{
+		return myValue.load(std::memory_order_acquire) == 0;
+	}
+};
+
+using JobFunction = std::function<void()>;
+using ParallelForFunction = std::function<void(u32 begin, u32 end)>;
+
+namespace JobSystem
+{
+	void Initialize(int coreCount);
+	void Shutdown();
+
+	// Worker threads plus the thread that called Initialize.
+	u32 GetThreadCount();
+	// 0 for the initializing thread, 1..N for workers and INVALID_THREAD_INDEX for foreign threads.
+	u32 GetThreadIndex();
+
+	void Run(JobCounter& counter, JobFunction job);
+
+	// Blocks until the counter reaches zero, executing other jobs in the meantime.
+	void Wait(JobCounter& counter);
+
+	// Splits [0, count) into batches of batchSize and blocks until all of them ran.
+	void ParallelFor(u32 count, u32 batchSize, const ParallelForFunction& job);
+
+	constexpr u32 INVALID_THREAD_INDEX = ~0u;
+}
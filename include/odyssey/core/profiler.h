@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+
+#include "odyssey/types.h"
+
+// Scoped CPU zones written out as a Chrome trace (chrome://tracing, ui.perfetto.dev) for a range of frames.
+// Every thread appends to a buffer of its own, so recording a zone takes no lock. Zones are only kept
+// while a capture is running, outside of one a zone costs a flag check.
+//
+// Instrument with PROFILE_SCOPE / PROFILE_FUNCTION, they compile to nothing unless USE_PROFILER is set.
+// Zone names are kept by pointer and have to outlive the capture, string literals in practice.
+namespace Profiler
+{
+	// Captures frames [firstFrame, firstFrame + frameCount) and writes them to path once the last one is
+	// done. A capture from frame 0 starts right away and so also holds the loading done before it.
+	void CaptureFrames(u64 firstFrame, u64 frameCount, const std::string& path);
+	// Called by the engine at the start of every frame
+	void BeginFrame(u64 frameIndex);
+	// Writes a capture the run ended in the middle of
+	void Shutdown();
+
+	// Shows up as the thread's name in the trace
+	void SetThreadName(const char* name);
+
+	// 0 when no capture is running, which EndZone ignores
+	u64 BeginZone();
+	void EndZone(const char* name, u64 start);
+
+	bool WriteChromeTrace(const std::string& path);
+}
+
+class ProfileZone
+{
+public:
+	ProfileZone(const char* name)
+		: myName(name), myStart(Profiler::BeginZone())
+	{
+	}
+
+	~ProfileZone()
+	{
+		Profiler::EndZone(myName, myStart);
+	}
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+	const char* myName{};
+	u64 myStart{};
+};
+
+#if USE_PROFILER
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_SCOPE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_THREAD(name) Profiler::SetThreadName(name)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD(name)
+
+#endif
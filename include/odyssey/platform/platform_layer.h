@@ -2,15 +2,29 @@
 
 #include "odyssey/types.h"
 
+// A read only view of a whole file, see PlatformLayer::MapFile
+struct MappedFile
+{
+	const u8* myData{};
+	size_t mySize{};
+	// Platform specific handles, only touched by the platform layer
+	void* myFileHandle{};
+	void* myMappingHandle{};
+};
+
 namespace PlatformLayer
 {
 	bool Initialize(const char* title, int x, int y, int width, int height);
 	void Shutdown();
 	bool PumpMessages();
+	bool IsHeadless();
 	double GetTimeSinceStartup();
+	u64 GetTimeNanoseconds();
 	void Sleep(long ms);
 	int GetCoreCount();
 	void SetArgs(int argc, char* argv[]);
 	Vector<std::string> GetArgs();
 	std::string GetBinPath();
+	bool MapFile(const std::string& path, MappedFile& outFile);
+	void UnmapFile(MappedFile& file);
 }
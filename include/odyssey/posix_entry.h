@@ -0,0 +1,21 @@
+#pragma once
+
+#include "game.h"
+#include "odyssey/core/engine.h"
+#include "odyssey/platform/platform_layer.h"
+
+extern Game* CreateGame();
+
+#if !IS_WINDOWS_PLATFORM
+
+int main(int argc, char* argv[])
+{
+	PlatformLayer::SetArgs(argc, argv);
+
+	Game* game = CreateGame();
+	Engine engine = Engine(game);
+	engine.Run();
+	return 0;
+}
+
+#endif
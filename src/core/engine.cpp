@@ -2,7 +2,71 @@
 
 #include "odyssey/platform/platform_layer.h"
 #include "odyssey/core/logger.h"
+#include "odyssey/core/job_system.h"
+#include "odyssey/core/profiler.h"
 #include "renderer/renderer_frontend.h"
+#include "renderer/renderer_backend.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+// One row per timed thing, CPU frame times next to the GPU scopes, all in milliseconds
+static void WriteTimings(const std::string& path, const FrameStats& frameStats, const RenderStats& renderStats)
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+	{
+		Logger::LogWarn("Failed to write timings to {}", path);
+		return;
+	}
+
+	file << "source,name,last_ms,min_ms,avg_ms,max_ms,samples\n";
+	file << fmt::format("cpu,Frame,{:.4f},{:.4f},{:.4f},{:.4f},{}\n",
+		frameStats.myLastFrameTime, frameStats.myMinFrameTime, frameStats.myAverageFrameTime, frameStats.myMaxFrameTime, std::min<u64>(frameStats.myFrameCount, FramePacer::HISTORY_SIZE));
+	for (const GPUScopeTiming& scope : renderStats.myGPUScopes)
+	{
+		file << fmt::format("gpu,{},{:.4f},{:.4f},{:.4f},{:.4f},{}\n",
+			scope.myName, scope.myLastTime, scope.myMinTime, scope.myAverageTime, scope.myMaxTime, scope.mySampleCount);
+	}
+
+	Logger::Log("Wrote timings to {}", path);
+}
+
+// --trace=<path> captures frames 0 to 119, --trace-frames=<first>:<count> picks others
+static void StartTraceCapture()
+{
+#if USE_PROFILER
+	std::string path;
+	u64 firstFrame = 0;
+	u64 frameCount = 120;
+
+	for (const std::string& arg : PlatformLayer::GetArgs())
+	{
+		if (arg.rfind("--trace=", 0) == 0)
+		{
+			path = arg.substr(strlen("--trace="));
+		}
+		else if (arg.rfind("--trace-frames=", 0) == 0)
+		{
+			const std::string range = arg.substr(strlen("--trace-frames="));
+			const size_t separator = range.find(':');
+			firstFrame = std::strtoull(range.c_str(), nullptr, 10);
+			if (separator != std::string::npos)
+				frameCount = std::strtoull(range.c_str() + separator + 1, nullptr, 10);
+		}
+	}
+
+	if (!path.empty())
+		Profiler::CaptureFrames(firstFrame, frameCount, path);
+#else
+	for (const std::string& arg : PlatformLayer::GetArgs())
+	{
+		if (arg.rfind("--trace=", 0) == 0)
+			Logger::LogWarn("Built without USE_PROFILER, there is no trace to write to {}", arg.substr(strlen("--trace=")));
+	}
+#endif
+}
 
 Engine::Engine(Game* game)
 	: myGame(game)
@@ -13,7 +77,11 @@ Engine::Engine(Game* game)
 	Logger::Log("Odyssey Engine warming up.....");
 
 	PlatformLayer::Initialize(myGame->GetName(), 100, 100, 1024, 600);
-	PlatformLayer::GetCoreCount();
+	JobSystem::Initialize(PlatformLayer::GetCoreCount());
+
+	PROFILE_THREAD("Main");
+	// Before the renderer so a capture from frame 0 has the loading in it
+	StartTraceCapture();
 	
 	RendererFrontend::Initialize(1024, 600);
 }
@@ -23,16 +91,85 @@ Engine::~Engine()
 	delete myGame;
 
 	RendererFrontend::Shutdown();
+
+	JobSystem::Shutdown();
+
+	Profiler::Shutdown();
 }
 
 void Engine::Run()
 {
+	RenderSnapshot directSnapshot{};
+	u64 frameIndex = 0;
+
+	if (myIsPipelined)
+		myFramePipeline.Start();
+
+	myFramePacer.Start();
+
 	while(PlatformLayer::PumpMessages())
 	{
-		myGame->Update(0.0f);
+		Profiler::BeginFrame(frameIndex);
+		PROFILE_SCOPE("Frame");
 
-		RendererFrontend::Render();
+		myFramePacer.BeginFrame();
 
-		PlatformLayer::Sleep(5);
+		while (myFramePacer.StepSimulation())
+		{
+			PROFILE_SCOPE("Game::Update");
+			myGame->Update(myFramePacer.GetFixedTimestep());
+			mySimulationTime += myFramePacer.GetFixedTimestep();
+		}
+
+		const float interpolation = myFramePacer.GetInterpolation();
+		{
+			PROFILE_SCOPE("Game::Render");
+			myGame->Render(interpolation);
+		}
+
+		RenderSnapshot& snapshot = myIsPipelined ? myFramePipeline.GetWriteSnapshot() : directSnapshot;
+		snapshot.myFrameIndex = frameIndex++;
+		snapshot.myInterpolation = interpolation;
+		snapshot.mySimulationTime = mySimulationTime + interpolation * myFramePacer.GetFixedTimestep();
+
+		if (myIsPipelined)
+			myFramePipeline.Submit();
+		else
+			RendererFrontend::Render(snapshot);
+
+		PROFILE_SCOPE("FramePacer::EndFrame");
+		myFramePacer.EndFrame();
+	}
+
+	myFramePipeline.Stop();
+
+	const FrameStats& stats = myFramePacer.GetStats();
+	Logger::Log("Ran {} frames, frame time avg {:.3f} ms min {:.3f} ms max {:.3f} ms jitter {:.3f} ms",
+		stats.myFrameCount, stats.myAverageFrameTime, stats.myMinFrameTime, stats.myMaxFrameTime, stats.myJitter);
+
+	const RenderStats renderStats = RendererFrontend::GetRenderStats();
+	Logger::Log("Last frame: {} draw calls for {} instances ({} culled), {} pipeline binds, {} descriptor set binds, {} vertex buffer binds",
+		renderStats.myDrawCalls, renderStats.myInstanceCount, renderStats.myCulledObjectCount, renderStats.myPipelineBinds, renderStats.myDescriptorSetBinds, renderStats.myVertexBufferBinds);
+	Logger::Log("Last frame: {:.2f} MB of geometry read, {:.2f} MB of it from host visible memory",
+		renderStats.myGeometryBytesRead / (1024.0 * 1024.0), renderStats.myHostGeometryBytesRead / (1024.0 * 1024.0));
+	Logger::Log("Geometry pool: {:.2f} of {:.2f} MB used, {:.1f}% fragmented",
+		renderStats.myGeometryPoolUsedBytes / (1024.0 * 1024.0), renderStats.myGeometryPoolCapacity / (1024.0 * 1024.0), renderStats.myGeometryPoolFragmentation * 100.0f);
+
+	std::string recordTimes;
+	for (size_t i = 0; i < renderStats.myThreadRecordTimes.size(); ++i)
+		recordTimes += fmt::format("{}{:.3f}", i > 0 ? ", " : "", renderStats.myThreadRecordTimes[i]);
+	Logger::Log("Last frame: {} secondary command buffers, recording ms per thread [{}]", renderStats.mySecondaryCommandBufferCount, recordTimes);
+	Logger::Log("Last frame: {} descriptor sets allocated, {} descriptor pools", renderStats.myDescriptorSetAllocations, renderStats.myDescriptorPoolCount);
+
+	for (const GPUScopeTiming& scope : renderStats.myGPUScopes)
+	{
+		Logger::Log("GPU {}: avg {:.3f} ms min {:.3f} ms max {:.3f} ms over {} frames",
+			scope.myName, scope.myAverageTime, scope.myMinTime, scope.myMaxTime, scope.mySampleCount);
+	}
+
+	for (const std::string& arg : PlatformLayer::GetArgs())
+	{
+		if (arg.rfind("--timings=", 0) == 0)
+			WriteTimings(arg.substr(strlen("--timings=")), stats, renderStats);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "odyssey/core/frame_pacer.h"
+#include "odyssey/platform/platform_layer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+constexpr u64 NANOSECONDS_PER_SECOND = 1000000000ull;
+constexpr double NANOSECONDS_PER_MILLISECOND = 1000000.0;
+
+// Long hitches (breakpoints, loading) must not turn into a burst of catch-up steps
+constexpr u64 MAX_FRAME_DELTA = NANOSECONDS_PER_SECOND / 4;
+constexpr u32 MAX_STEPS_PER_FRAME = 8;
+
+void FramePacer::SetTargetFrameRate(double framesPerSecond)
+{
+	myTargetFrameTime = framesPerSecond > 0.0 ? static_cast<u64>(NANOSECONDS_PER_SECOND / framesPerSecond) : 0;
+	myNextDeadline = myLastFrameStart + myTargetFrameTime;
+}
+
+double FramePacer::GetTargetFrameRate() const
+{
+	return myTargetFrameTime > 0 ? static_cast<double>(NANOSECONDS_PER_SECOND) / myTargetFrameTime : 0.0;
+}
+
+void FramePacer::SetFixedTimestep(double seconds)
+{
+	myFixedTimestep = std::max<u64>(1, static_cast<u64>(seconds * NANOSECONDS_PER_SECOND));
+}
+
+float FramePacer::GetFixedTimestep() const
+{
+	return static_cast<float>(static_cast<double>(myFixedTimestep) / NANOSECONDS_PER_SECOND);
+}
+
+void FramePacer::Start()
+{
+	myLastFrameStart = PlatformLayer::GetTimeNanoseconds();
+	myNextDeadline = myLastFrameStart + myTargetFrameTime;
+	myAccumulator = 0;
+	myIsFirstFrame = true;
+}
+
+void FramePacer::BeginFrame()
+{
+	const u64 now = PlatformLayer::GetTimeNanoseconds();
+	const u64 frameTime = now - myLastFrameStart;
+	myLastFrameStart = now;
+
+	// Nothing happened between Start and the first frame, don't let it skew the stats
+	if (!myIsFirstFrame)
+		UpdateStats(frameTime);
+	myIsFirstFrame = false;
+
+	myAccumulator += std::min(frameTime, MAX_FRAME_DELTA);
+	myStepsThisFrame = 0;
+}
+
+bool FramePacer::StepSimulation()
+{
+	if (myAccumulator < myFixedTimestep)
+		return false;
+
+	if (myStepsThisFrame == MAX_STEPS_PER_FRAME)
+	{
+		// The simulation can't keep up, drop the backlog instead of spiralling
+		myStats.myDroppedSimulationSteps += myAccumulator / myFixedTimestep;
+		myAccumulator %= myFixedTimestep;
+		return false;
+	}
+
+	myAccumulator -= myFixedTimestep;
+	++myStepsThisFrame;
+	++myStats.mySimulationStepCount;
+	return true;
+}
+
+void FramePacer::EndFrame()
+{
+	if (myTargetFrameTime == 0)
+		return;
+
+	WaitUntil(myNextDeadline);
+
+	// Schedule against the previous deadline to avoid drift, but don't try to catch up after a long frame
+	const u64 now = PlatformLayer::GetTimeNanoseconds();
+	myNextDeadline += myTargetFrameTime;
+	if (myNextDeadline <= now)
+		myNextDeadline = now + myTargetFrameTime;
+}
+
+float FramePacer::GetInterpolation() const
+{
+	return static_cast<float>(static_cast<double>(myAccumulator) / myFixedTimestep);
+}
+
+const FrameStats& FramePacer::GetStats() const
+{
+	return myStats;
+}
+
+void FramePacer::GetFrameTimeHistory(Vector<float>& outHistory) const
+{
+	outHistory.resize(myHistoryCount);
+	const u32 oldest = (myHistoryHead + HISTORY_SIZE - myHistoryCount) % HISTORY_SIZE;
+	for (u32 i = 0; i < myHistoryCount; ++i)
+		outHistory[i] = myFrameTimes[(oldest + i) % HISTORY_SIZE];
+}
+
+void FramePacer::WaitUntil(u64 deadline)
+{
+	// Sleep while the OS scheduler can't make us miss the deadline, spin for the rest
+	u64 now = PlatformLayer::GetTimeNanoseconds();
+	while (now < deadline && deadline - now > mySleepOvershoot)
+	{
+		PlatformLayer::Sleep(1);
+		const u64 afterSleep = PlatformLayer::GetTimeNanoseconds();
+		// Track the worst recent sleep but let a single hiccup fade out again
+		mySleepOvershoot = std::max(afterSleep - now, mySleepOvershoot - mySleepOvershoot / 64);
+		now = afterSleep;
+	}
+
+	while (now < deadline)
+	{
+		std::this_thread::yield();
+		now = PlatformLayer::GetTimeNanoseconds();
+	}
+}
+
+void FramePacer::UpdateStats(u64 frameTime)
+{
+	myFrameTimes[myHistoryHead] = static_cast<float>(frameTime / NANOSECONDS_PER_MILLISECOND);
+	myHistoryHead = (myHistoryHead + 1) % HISTORY_SIZE;
+	myHistoryCount = std::min(myHistoryCount + 1, HISTORY_SIZE);
+
+	double sum = 0.0;
+	double minTime = myFrameTimes[(myHistoryHead + HISTORY_SIZE - 1) % HISTORY_SIZE];
+	double maxTime = minTime;
+	for (u32 i = 0; i < myHistoryCount; ++i)
+	{
+		const double time = myFrameTimes[i];
+		sum += time;
+		minTime = std::min(minTime, time);
+		maxTime = std::max(maxTime, time);
+	}
+	const double average = sum / myHistoryCount;
+
+	double variance = 0.0;
+	for (u32 i = 0; i < myHistoryCount; ++i)
+	{
+		const double difference = myFrameTimes[i] - average;
+		variance += difference * difference;
+	}
+
+	myStats.myLastFrameTime = frameTime / NANOSECONDS_PER_MILLISECOND;
+	myStats.myAverageFrameTime = average;
+	myStats.myMinFrameTime = minTime;
+	myStats.myMaxFrameTime = maxTime;
+	myStats.myJitter = std::sqrt(variance / myHistoryCount);
+	++myStats.myFrameCount;
+}
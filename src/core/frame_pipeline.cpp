@@ -0,0 +1,98 @@
+#include "odyssey/core/frame_pipeline.h"
+#include "odyssey/core/logger.h"
+#include "odyssey/core/profiler.h"
+#include "odyssey/platform/platform_layer.h"
+#include "renderer/renderer_frontend.h"
+
+#include <algorithm>
+
+constexpr double NANOSECONDS_PER_MILLISECOND = 1000000.0;
+
+void FramePipeline::Start()
+{
+	myIsRunning = true;
+	myRenderThread = std::thread(&FramePipeline::RenderThreadLoop, this);
+	Logger::Log("Pipelined rendering enabled.");
+}
+
+void FramePipeline::Stop()
+{
+	if (!myIsRunning)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(myMutex);
+		myIsRunning = false;
+	}
+	myCondition.notify_all();
+	myRenderThread.join();
+}
+
+RenderSnapshot& FramePipeline::GetWriteSnapshot()
+{
+	return mySnapshots[myWriteIndex];
+}
+
+void FramePipeline::Submit()
+{
+	const u64 stallStart = PlatformLayer::GetTimeNanoseconds();
+	mySnapshots[myWriteIndex].mySubmitTime = stallStart;
+
+	std::unique_lock<std::mutex> lock(myMutex);
+
+	// The render thread has to pick up the previous snapshot before we queue the next one
+	myCondition.wait(lock, [this] { return !myHasPending; });
+	myPendingIndex = myWriteIndex;
+	myHasPending = true;
+	myWriteIndex ^= 1;
+	myCondition.notify_all();
+
+	// Don't start writing into the buffer the render thread is still reading from
+	myCondition.wait(lock, [this] { return !myIsRendering || myRenderingIndex != myWriteIndex; });
+
+	myStats.myLastStall = (PlatformLayer::GetTimeNanoseconds() - stallStart) / NANOSECONDS_PER_MILLISECOND;
+}
+
+FramePipelineStats FramePipeline::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(myMutex);
+	return myStats;
+}
+
+void FramePipeline::RenderThreadLoop()
+{
+	PROFILE_THREAD("Render");
+
+	while (true)
+	{
+		u32 index = 0;
+		{
+			std::unique_lock<std::mutex> lock(myMutex);
+			myCondition.wait(lock, [this] { return myHasPending || !myIsRunning; });
+			if (!myHasPending)
+				break;
+
+			index = myPendingIndex;
+			myRenderingIndex = index;
+			myIsRendering = true;
+			myHasPending = false;
+		}
+		myCondition.notify_all();
+
+		const RenderSnapshot& snapshot = mySnapshots[index];
+		RendererFrontend::Render(snapshot);
+
+		const double latency = (PlatformLayer::GetTimeNanoseconds() - snapshot.mySubmitTime) / NANOSECONDS_PER_MILLISECOND;
+		{
+			std::lock_guard<std::mutex> lock(myMutex);
+			myIsRendering = false;
+
+			myStats.myLastLatency = latency;
+			myStats.myAverageLatency = myStats.myRenderedFrameCount == 0 ? latency : myStats.myAverageLatency * 0.95 + latency * 0.05;
+			myStats.myMaxLatency = std::max(myStats.myMaxLatency, latency);
+			myStats.myLastRenderedFrameIndex = snapshot.myFrameIndex;
+			++myStats.myRenderedFrameCount;
+		}
+		myCondition.notify_all();
+	}
+}
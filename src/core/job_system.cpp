@@ -0,0 +1,305 @@
+#include "odyssey/core/job_system.h"
+#include "odyssey/core/logger.h"
+#include "odyssey/core/profiler.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+
+namespace
+{
+	struct Job
+	{
+		JobFunction myFunction{};
+		JobCounter* myCounter{};
+	};
+
+	// Chase-Lev work stealing deque. The owning thread pushes and pops at the bottom,
+	// every other thread steals from the top.
+	class WorkStealingQueue
+	{
+	public:
+		static constexpr i64 CAPACITY = 4096;
+		static constexpr i64 MASK = CAPACITY - 1;
+
+		bool Push(Job* job)
+		{
+			const i64 bottom = myBottom.load(std::memory_order_relaxed);
+			const i64 top = myTop.load(std::memory_order_acquire);
+			if (bottom - top >= CAPACITY)
+				return false;
+
+			myJobs[bottom & MASK].store(job, std::memory_order_release);
+			std::atomic_thread_fence(std::memory_order_release);
+			myBottom.store(bottom + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		Job* Pop()
+		{
+			const i64 bottom = myBottom.load(std::memory_order_relaxed) - 1;
+			myBottom.store(bottom, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			i64 top = myTop.load(std::memory_order_relaxed);
+
+			if (top > bottom)
+			{
+				myBottom.store(bottom + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+
+			Job* job = myJobs[bottom & MASK].load(std::memory_order_relaxed);
+			if (top == bottom)
+			{
+				// Last job, race against the thieves for it
+				if (!myTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					job = nullptr;
+				myBottom.store(bottom + 1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		Job* Steal()
+		{
+			i64 top = myTop.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const i64 bottom = myBottom.load(std::memory_order_acquire);
+
+			if (top >= bottom)
+				return nullptr;
+
+			Job* job = myJobs[top & MASK].load(std::memory_order_acquire);
+			if (!myTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return nullptr;
+			return job;
+		}
+
+	private:
+		alignas(64) std::atomic<i64> myTop{};
+		alignas(64) std::atomic<i64> myBottom{};
+		std::atomic<Job*> myJobs[CAPACITY]{};
+	};
+}
+
+static Vector<std::unique_ptr<WorkStealingQueue>> locQueues{};
+static Vector<std::thread> locWorkers{};
+
+// Jobs submitted from threads that are not owned by the job system
+static std::deque<Job*> locInjectedJobs{};
+static std::mutex locInjectedMutex{};
+
+static std::atomic<i32> locPendingJobs{};
+static std::atomic<i32> locSleepingWorkers{};
+static std::mutex locSleepMutex{};
+static std::condition_variable locWakeCondition{};
+static std::atomic<bool> locIsRunning{};
+
+static thread_local u32 locThreadIndex = JobSystem::INVALID_THREAD_INDEX;
+static thread_local u32 locStealSeed = 0;
+
+static void WakeWorker()
+{
+	if (locSleepingWorkers.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(locSleepMutex);
+		}
+		locWakeCondition.notify_one();
+	}
+}
+
+static void Execute(Job* job)
+{
+	job->myFunction();
+	if (job->myCounter)
+		job->myCounter->myValue.fetch_sub(1, std::memory_order_release);
+	delete job;
+}
+
+static Job* FindJob()
+{
+	if (locPendingJobs.load(std::memory_order_relaxed) <= 0)
+		return nullptr;
+
+	const u32 queueCount = static_cast<u32>(locQueues.size());
+
+	Job* job = nullptr;
+	if (locThreadIndex < queueCount)
+		job = locQueues[locThreadIndex]->Pop();
+
+	if (!job)
+	{
+		std::lock_guard<std::mutex> lock(locInjectedMutex);
+		if (!locInjectedJobs.empty())
+		{
+			job = locInjectedJobs.front();
+			locInjectedJobs.pop_front();
+		}
+	}
+
+	if (!job && queueCount > 0)
+	{
+		// xorshift to pick the first victim so thieves don't all hammer the same queue
+		locStealSeed ^= locStealSeed << 13;
+		locStealSeed ^= locStealSeed >> 17;
+		locStealSeed ^= locStealSeed << 5;
+		const u32 start = locStealSeed % queueCount;
+		for (u32 i = 0; i < queueCount && !job; ++i)
+		{
+			const u32 victim = (start + i) % queueCount;
+			if (victim != locThreadIndex)
+				job = locQueues[victim]->Steal();
+		}
+	}
+
+	if (job)
+		locPendingJobs.fetch_sub(1);
+
+	return job;
+}
+
+static void WorkerLoop(u32 threadIndex)
+{
+	locThreadIndex = threadIndex;
+	locStealSeed = 0x9E3779B9u * (threadIndex + 1);
+	PROFILE_THREAD(fmt::format("Worker {}", threadIndex).c_str());
+
+	constexpr int SPIN_COUNT = 64;
+	int idleSpins = 0;
+
+	while (locIsRunning.load())
+	{
+		if (Job* job = FindJob())
+		{
+			Execute(job);
+			idleSpins = 0;
+			continue;
+		}
+
+		if (++idleSpins < SPIN_COUNT)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(locSleepMutex);
+		locSleepingWorkers.fetch_add(1);
+		locWakeCondition.wait(lock, [] { return locPendingJobs.load() > 0 || !locIsRunning.load(); });
+		locSleepingWorkers.fetch_sub(1);
+		idleSpins = 0;
+	}
+}
+
+void JobSystem::Initialize(int coreCount)
+{
+	const u32 threadCount = coreCount > 1 ? static_cast<u32>(coreCount) : 1;
+
+	locIsRunning = true;
+	locThreadIndex = 0;
+	locStealSeed = 0x9E3779B9u;
+
+	for (u32 i = 0; i < threadCount; ++i)
+		locQueues.push_back(std::make_unique<WorkStealingQueue>());
+
+	for (u32 i = 1; i < threadCount; ++i)
+		locWorkers.emplace_back(WorkerLoop, i);
+
+	Logger::Log("Job system started with {} worker threads.", threadCount - 1);
+}
+
+void JobSystem::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(locSleepMutex);
+		locIsRunning = false;
+	}
+	locWakeCondition.notify_all();
+
+	for (std::thread& worker : locWorkers)
+		worker.join();
+
+	// Whatever is left never got picked up, run it here so no counter stays pending
+	while (Job* job = FindJob())
+		Execute(job);
+
+	locWorkers.clear();
+	locQueues.clear();
+	locThreadIndex = INVALID_THREAD_INDEX;
+}
+
+u32 JobSystem::GetThreadCount()
+{
+	return static_cast<u32>(locQueues.size());
+}
+
+u32 JobSystem::GetThreadIndex()
+{
+	return locThreadIndex;
+}
+
+void JobSystem::Run(JobCounter& counter, JobFunction job)
+{
+	counter.myValue.fetch_add(1, std::memory_order_relaxed);
+
+	Job* newJob = new Job{ std::move(job), &counter };
+
+	if (!locIsRunning.load(std::memory_order_relaxed))
+	{
+		Execute(newJob);
+		return;
+	}
+
+	if (locThreadIndex < locQueues.size())
+	{
+		if (!locQueues[locThreadIndex]->Push(newJob))
+		{
+			// Our deque is full, doing the work right away is the cheapest back pressure
+			Execute(newJob);
+			return;
+		}
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(locInjectedMutex);
+		locInjectedJobs.push_back(newJob);
+	}
+
+	locPendingJobs.fetch_add(1);
+	WakeWorker();
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	while (!counter.IsDone())
+	{
+		if (Job* job = FindJob())
+			Execute(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::ParallelFor(u32 count, u32 batchSize, const ParallelForFunction& job)
+{
+	if (count == 0)
+		return;
+
+	if (batchSize == 0)
+		batchSize = 1;
+
+	if (count <= batchSize || GetThreadCount() <= 1)
+	{
+		job(0, count);
+		return;
+	}
+
+	JobCounter counter{};
+	for (u32 begin = 0; begin < count; begin += batchSize)
+	{
+		const u32 end = begin + batchSize < count ? begin + batchSize : count;
+		Run(counter, [&job, begin, end]() { job(begin, end); });
+	}
+	Wait(counter);
+}
@@ -2,7 +2,11 @@
 
 #include <spdlog/async.h>
 #include <spdlog/sinks/basic_file_sink.h>
+#if IS_WINDOWS_PLATFORM
 #include <spdlog/sinks/msvc_sink.h>
+#else
+#include <spdlog/sinks/stdout_color_sinks.h>
+#endif
 
 std::shared_ptr<spdlog::logger> Logger::myLogger = nullptr;
 
@@ -15,5 +19,11 @@ void Logger::Initialize()
 	myLogger->sinks().push_back(std::make_shared<spdlog::sinks::msvc_sink_mt>());
 	spdlog::set_default_logger(myLogger);
 	myLogger->set_pattern("%+");
+#else
+	std::remove("log.txt");
+	myLogger = spdlog::basic_logger_mt("Engine", "log.txt");
+	myLogger->sinks().push_back(std::make_shared<spdlog::sinks::stdout_color_sink_mt>());
+	spdlog::set_default_logger(myLogger);
+	myLogger->set_pattern("%+");
 #endif
 }
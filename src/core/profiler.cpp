@@ -0,0 +1,217 @@
+#include "odyssey/core/profiler.h"
+#include "odyssey/core/logger.h"
+#include "odyssey/platform/platform_layer.h"
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+	struct ZoneEvent
+	{
+		const char* myName{};
+		u64 myStart{};
+		u64 myEnd{};
+	};
+
+	// Only the owning thread writes, it publishes an event by bumping the count so the
+	// trace writer can read everything below it while the thread keeps recording
+	struct ThreadBuffer
+	{
+		static constexpr u32 CAPACITY = 64 * 1024;
+
+		std::unique_ptr<ZoneEvent[]> myEvents{};
+		std::atomic<u32> myCount{};
+		std::atomic<u32> myDroppedCount{};
+		// Guarded by locBuffersMutex
+		std::string myName{};
+		u32 myThreadId{};
+	};
+}
+
+static std::mutex locBuffersMutex{};
+static Vector<std::unique_ptr<ThreadBuffer>> locBuffers{};
+static thread_local ThreadBuffer* locThreadBuffer{};
+
+static std::atomic<bool> locIsRecording{};
+static bool locHasCapture{};
+static u64 locFirstFrame{};
+static u64 locEndFrame{};
+static u64 locCaptureStart{};
+static std::string locTracePath{};
+
+static ThreadBuffer& GetThreadBuffer()
+{
+	if (!locThreadBuffer)
+	{
+		std::lock_guard<std::mutex> lock(locBuffersMutex);
+		locBuffers.push_back(std::make_unique<ThreadBuffer>());
+		locThreadBuffer = locBuffers.back().get();
+		locThreadBuffer->myThreadId = static_cast<u32>(locBuffers.size() - 1);
+		locThreadBuffer->myName = fmt::format("Thread {}", locThreadBuffer->myThreadId);
+	}
+	return *locThreadBuffer;
+}
+
+static void StartRecording()
+{
+	locCaptureStart = PlatformLayer::GetTimeNanoseconds();
+	locIsRecording.store(true, std::memory_order_release);
+}
+
+static void StopRecording()
+{
+	locIsRecording.store(false, std::memory_order_release);
+	locHasCapture = false;
+	Profiler::WriteChromeTrace(locTracePath);
+}
+
+static void AppendEscaped(std::string& out, const char* text)
+{
+	for (; *text; ++text)
+	{
+		if (*text == '"' || *text == '\\')
+			out += '\\';
+		out += *text;
+	}
+}
+
+void Profiler::CaptureFrames(u64 firstFrame, u64 frameCount, const std::string& path)
+{
+	if (frameCount == 0)
+		return;
+
+	locFirstFrame = firstFrame;
+	locEndFrame = firstFrame + frameCount;
+	locTracePath = path;
+	locHasCapture = true;
+
+	if (firstFrame == 0)
+		StartRecording();
+
+	Logger::Log("Capturing a trace of frames {} to {} into {}", locFirstFrame, locEndFrame - 1, locTracePath);
+}
+
+void Profiler::BeginFrame(u64 frameIndex)
+{
+	if (!locHasCapture)
+		return;
+
+	if (frameIndex == locFirstFrame && !locIsRecording.load(std::memory_order_relaxed))
+		StartRecording();
+	// Writing the trace hitches this frame, it is past the range so that doesn't show up in it
+	else if (frameIndex == locEndFrame)
+		StopRecording();
+}
+
+void Profiler::Shutdown()
+{
+	if (locHasCapture && locIsRecording.load(std::memory_order_relaxed))
+		StopRecording();
+
+	locHasCapture = false;
+	locIsRecording = false;
+
+	// Every thread that recorded has been joined by now, apart from this one
+	std::lock_guard<std::mutex> lock(locBuffersMutex);
+	locBuffers.clear();
+	locThreadBuffer = nullptr;
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	std::lock_guard<std::mutex> lock(locBuffersMutex);
+	buffer.myName = name;
+}
+
+u64 Profiler::BeginZone()
+{
+	if (!locIsRecording.load(std::memory_order_relaxed))
+		return 0;
+
+	return PlatformLayer::GetTimeNanoseconds();
+}
+
+void Profiler::EndZone(const char* name, u64 start)
+{
+	// Zones still open when the capture stopped are left out rather than cut off
+	if (start == 0 || !locIsRecording.load(std::memory_order_acquire))
+		return;
+
+	const u64 end = PlatformLayer::GetTimeNanoseconds();
+
+	ThreadBuffer& buffer = GetThreadBuffer();
+	if (!buffer.myEvents)
+		buffer.myEvents = std::make_unique<ZoneEvent[]>(ThreadBuffer::CAPACITY);
+
+	const u32 count = buffer.myCount.load(std::memory_order_relaxed);
+	if (count >= ThreadBuffer::CAPACITY)
+	{
+		buffer.myDroppedCount.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	buffer.myEvents[count] = { name, start, end };
+	buffer.myCount.store(count + 1, std::memory_order_release);
+}
+
+bool Profiler::WriteChromeTrace(const std::string& path)
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+	{
+		Logger::LogWarn("Failed to write a trace to {}", path);
+		return false;
+	}
+
+	std::string json;
+	json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+	u32 zoneCount = 0;
+	u32 droppedCount = 0;
+	bool isFirst = true;
+
+	std::lock_guard<std::mutex> lock(locBuffersMutex);
+	for (const std::unique_ptr<ThreadBuffer>& buffer : locBuffers)
+	{
+		const u32 count = buffer->myCount.load(std::memory_order_acquire);
+		droppedCount += buffer->myDroppedCount.load(std::memory_order_relaxed);
+
+		json += isFirst ? "" : ",\n";
+		json += fmt::format("{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"", buffer->myThreadId);
+		AppendEscaped(json, buffer->myName.c_str());
+		json += "\"}}";
+		isFirst = false;
+
+		for (u32 i = 0; i < count; ++i)
+		{
+			const ZoneEvent& zone = buffer->myEvents[i];
+			// Chrome traces are in microseconds
+			const double begin = zone.myStart >= locCaptureStart ? (zone.myStart - locCaptureStart) / 1000.0 : 0.0;
+			const double duration = (zone.myEnd - zone.myStart) / 1000.0;
+
+			json += ",\n{\"name\":\"";
+			AppendEscaped(json, zone.myName);
+			json += fmt::format("\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}", buffer->myThreadId, begin, duration);
+		}
+		zoneCount += count;
+
+		if (json.size() > 1024 * 1024)
+		{
+			file << json;
+			json.clear();
+		}
+	}
+
+	json += "\n]}\n";
+	file << json;
+
+	if (droppedCount > 0)
+		Logger::LogWarn("Trace is missing {} zones, a thread ran out of room for them", droppedCount);
+	Logger::Log("Wrote a trace of {} zones over {} threads to {}", zoneCount, locBuffers.size(), path);
+	return true;
+}
@@ -0,0 +1,211 @@
+#include "odyssey/platform/platform_layer.h"
+
+#if !IS_WINDOWS_PLATFORM
+
+#include "odyssey/core/logger.h"
+
+#if USE_VULKAN
+#include "renderer/vulkan/vulkan_backend.h"
+#endif
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// There is no windowing on this layer, it always runs headless. PumpMessages keeps the
+// engine loop going until --frames=N frames have been pumped or the process is interrupted.
+
+static Vector<std::string> locArgs{};
+static timespec locStartTime{};
+static i64 locFrameLimit{};
+static i64 locFrameCount{};
+static std::atomic<bool> locQuitRequested{};
+
+static void OnQuitSignal(int)
+{
+	locQuitRequested = true;
+}
+
+static u64 TimespecToNanoseconds(const timespec& time)
+{
+	return static_cast<u64>(time.tv_sec) * 1000000000ull + static_cast<u64>(time.tv_nsec);
+}
+
+bool PlatformLayer::Initialize(const char* title, int x, int y, int width, int height)
+{
+	clock_gettime(CLOCK_MONOTONIC, &locStartTime);
+
+	std::signal(SIGINT, OnQuitSignal);
+	std::signal(SIGTERM, OnQuitSignal);
+
+	for (const std::string& arg : locArgs)
+	{
+		if (arg.rfind("--frames=", 0) == 0)
+			locFrameLimit = std::strtoll(arg.c_str() + strlen("--frames="), nullptr, 10);
+	}
+
+	Logger::Log("Running {} headless with a virtual {}x{} window at {} {}", title, width, height, x, y);
+	if (locFrameLimit > 0)
+		Logger::Log("Stopping after {} frames", locFrameLimit);
+
+	return true;
+}
+
+void PlatformLayer::Shutdown()
+{
+}
+
+bool PlatformLayer::PumpMessages()
+{
+	if (locQuitRequested)
+		return false;
+
+	if (locFrameLimit > 0 && locFrameCount >= locFrameLimit)
+		return false;
+
+	++locFrameCount;
+	return true;
+}
+
+bool PlatformLayer::IsHeadless()
+{
+	return true;
+}
+
+double PlatformLayer::GetTimeSinceStartup()
+{
+	return static_cast<double>(GetTimeNanoseconds()) / 1000000000.0;
+}
+
+u64 PlatformLayer::GetTimeNanoseconds()
+{
+	timespec now{};
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return TimespecToNanoseconds(now) - TimespecToNanoseconds(locStartTime);
+}
+
+void PlatformLayer::Sleep(long ms)
+{
+	timespec duration{};
+	duration.tv_sec = ms / 1000;
+	duration.tv_nsec = (ms % 1000) * 1000000;
+	while (nanosleep(&duration, &duration) != 0 && errno == EINTR && !locQuitRequested)
+	{
+	}
+}
+
+int PlatformLayer::GetCoreCount()
+{
+	int count = 0;
+
+#if defined(__linux__)
+	// Respect taskset / cgroup cpusets, we don't want more workers than cores we may run on
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0)
+		count = CPU_COUNT(&set);
+#endif
+
+	if (count <= 0)
+		count = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+
+	if (count <= 0)
+		count = 1;
+
+	Logger::Log("{} cores detected.", count);
+	return count;
+}
+
+void PlatformLayer::SetArgs(int argc, char* argv[])
+{
+	locArgs.clear();
+	for (int i = 0; i < argc; ++i)
+		locArgs.push_back(argv[i]);
+}
+
+Vector<std::string> PlatformLayer::GetArgs()
+{
+	return locArgs;
+}
+
+std::string PlatformLayer::GetBinPath()
+{
+	std::string path;
+
+	char buffer[4096];
+	const ssize_t length = readlink("/proc/self/exe", buffer, sizeof(buffer) - 1);
+	if (length > 0)
+		path.assign(buffer, static_cast<size_t>(length));
+	else if (!locArgs.empty())
+		path = locArgs[0];
+
+	return path.substr(0, path.find_last_of('/'));
+}
+
+bool PlatformLayer::MapFile(const std::string& path, MappedFile& outFile)
+{
+	outFile = {};
+
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat status{};
+	if (fstat(fd, &status) != 0 || status.st_size <= 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	const size_t size = static_cast<size_t>(status.st_size);
+	void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// The mapping keeps the file alive on its own
+	close(fd);
+
+	if (data == MAP_FAILED)
+	{
+		Logger::LogError("Failed to map {}: {}", path, strerror(errno));
+		return false;
+	}
+
+	// Everything is read front to back right after mapping, let the kernel read ahead
+	madvise(data, size, MADV_WILLNEED);
+
+	outFile.myData = static_cast<const u8*>(data);
+	outFile.mySize = size;
+	return true;
+}
+
+void PlatformLayer::UnmapFile(MappedFile& file)
+{
+	if (file.myData)
+		munmap(const_cast<u8*>(file.myData), file.mySize);
+
+	file = {};
+}
+
+#if USE_VULKAN
+
+// Headless, the backend renders offscreen and presents nothing
+VkSurfaceKHR PlatformLayer::GetVulkanSurface(VkInstance /*instance*/)
+{
+	return VK_NULL_HANDLE;
+}
+
+bool PlatformLayer::GetVulkanExtensionNames(std::vector<const char*>& /*names*/)
+{
+	return true;
+}
+
+#endif
+
+#endif
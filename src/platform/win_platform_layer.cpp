@@ -54,11 +54,30 @@ bool PlatformLayer::PumpMessages()
 	return !glfwWindowShouldClose(locWindow);
 }
 
+bool PlatformLayer::IsHeadless()
+{
+	return false;
+}
+
 double PlatformLayer::GetTimeSinceStartup()
 {
 	return glfwGetTime();
 }
 
+u64 PlatformLayer::GetTimeNanoseconds()
+{
+	static const LARGE_INTEGER frequency = []() { LARGE_INTEGER value; QueryPerformanceFrequency(&value); return value; }();
+	static const LARGE_INTEGER start = []() { LARGE_INTEGER value; QueryPerformanceCounter(&value); return value; }();
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+
+	// Split into seconds and remainder so the multiplication can't overflow
+	const u64 elapsed = static_cast<u64>(counter.QuadPart - start.QuadPart);
+	const u64 ticksPerSecond = static_cast<u64>(frequency.QuadPart);
+	return (elapsed / ticksPerSecond) * 1000000000ull + (elapsed % ticksPerSecond) * 1000000000ull / ticksPerSecond;
+}
+
 void PlatformLayer::Sleep(long ms)
 {
 	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
@@ -93,6 +112,51 @@ std::string PlatformLayer::GetBinPath()
 	return arg0.substr(0, arg0.find_last_of('/'));
 }
 
+bool PlatformLayer::MapFile(const std::string& path, MappedFile& outFile)
+{
+	outFile = {};
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!data)
+	{
+		Logger::LogError("Failed to map {}: error {}", path, GetLastError());
+		if (mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	outFile.myData = static_cast<const u8*>(data);
+	outFile.mySize = static_cast<size_t>(size.QuadPart);
+	outFile.myFileHandle = file;
+	outFile.myMappingHandle = mapping;
+	return true;
+}
+
+void PlatformLayer::UnmapFile(MappedFile& file)
+{
+	if (file.myData)
+		UnmapViewOfFile(file.myData);
+	if (file.myMappingHandle)
+		CloseHandle(file.myMappingHandle);
+	if (file.myFileHandle)
+		CloseHandle(file.myFileHandle);
+
+	file = {};
+}
+
 VkSurfaceKHR PlatformLayer::GetVulkanSurface(VkInstance instance)
 {
 	VkSurfaceKHR surface{};
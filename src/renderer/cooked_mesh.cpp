@@ -0,0 +1,88 @@
+#include "cooked_mesh.h"
+
+#include "odyssey/core/logger.h"
+
+#include <cstdio>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<CookedMeshHeader>::value, "CookedMeshHeader is written and read as raw bytes");
+static_assert(sizeof(CookedMeshHeader) % CookedMesh::STREAM_ALIGNMENT == 0, "Streams start right after the header");
+
+static bool IsInside(u64 offset, u64 size, size_t fileSize)
+{
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+bool CookedMesh::Validate(const u8* data, size_t size, const String& name)
+{
+    if (size < sizeof(CookedMeshHeader))
+    {
+        Logger::LogError("{} is too small to be a cooked mesh", name);
+        return false;
+    }
+
+    const CookedMeshHeader& header = *reinterpret_cast<const CookedMeshHeader*>(data);
+    if (header.myMagic != MAGIC)
+    {
+        Logger::LogError("{} is not a cooked mesh", name);
+        return false;
+    }
+
+    if (header.myVersion != VERSION)
+    {
+        Logger::LogWarn("{} was cooked with version {}, expected {}, it needs to be cooked again", name, header.myVersion, VERSION);
+        return false;
+    }
+
+    // Every vertex attribute is 4 byte aligned, whether the format is one the renderer uses is up to it
+    const bool validVertexStride = header.myVertexStride > 0 && header.myVertexStride % sizeof(u32) == 0;
+    const bool validIndexStride = header.myIndexStride == sizeof(u16) || header.myIndexStride == sizeof(u32);
+    const bool validSizes = validVertexStride && validIndexStride
+        && header.myVertexSize == static_cast<u64>(header.myVertexCount) * header.myVertexStride
+        && header.myIndexSize == static_cast<u64>(header.myIndexCount) * header.myIndexStride;
+    const bool validOffsets = header.myVertexOffset % STREAM_ALIGNMENT == 0 && header.myIndexOffset % STREAM_ALIGNMENT == 0
+        && IsInside(header.myVertexOffset, header.myVertexSize, size)
+        && IsInside(header.myIndexOffset, header.myIndexSize, size);
+
+    if (!validSizes || !validOffsets)
+    {
+        Logger::LogError("{} is corrupt", name);
+        return false;
+    }
+
+    return true;
+}
+
+bool CookedMesh::Write(const String& filename, const CookedMeshHeader& header, const void* vertexData, const void* indexData)
+{
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (!file)
+    {
+        Logger::LogError("Failed to open {} for writing", filename);
+        return false;
+    }
+
+    static const u8 padding[STREAM_ALIGNMENT]{};
+
+    u64 offset = 0;
+    bool success = true;
+    const auto write = [&](u64 streamOffset, const void* data, u64 size)
+    {
+        if (streamOffset > offset)
+            success &= fwrite(padding, 1, streamOffset - offset, file) == streamOffset - offset;
+        if (size > 0)
+            success &= fwrite(data, 1, size, file) == size;
+        offset = streamOffset + size;
+    };
+
+    write(0, &header, sizeof(header));
+    write(header.myVertexOffset, vertexData, header.myVertexSize);
+    write(header.myIndexOffset, indexData, header.myIndexSize);
+    write(AlignStream(offset), nullptr, 0);
+
+    success &= fclose(file) == 0;
+    if (!success)
+        Logger::LogError("Failed to write {}", filename);
+
+    return success;
+}
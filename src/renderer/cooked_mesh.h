@@ -0,0 +1,57 @@
+#pragma once
+
+#include "odyssey/types.h"
+
+// Binary mesh blob written offline by tools/mesh_cooker. Everything the renderer needs is laid
+// out ready to go, so loading is mapping the file and copying the streams into GPU buffers.
+//
+// Layout: CookedMeshHeader | vertex stream | index stream, every part 16 byte aligned.
+
+namespace CookedMesh
+{
+    // "ODYM" read as a little endian u32
+    constexpr u32 MAGIC = 0x4D59444F;
+    // Bump whenever the layout, or the vertex or index formats behind it, change
+    constexpr u32 VERSION = 1;
+    constexpr u64 STREAM_ALIGNMENT = 16;
+    constexpr const char* EXTENSION = ".mesh";
+
+    constexpr u64 AlignStream(u64 offset)
+    {
+        return (offset + STREAM_ALIGNMENT - 1) & ~(STREAM_ALIGNMENT - 1);
+    }
+}
+
+struct alignas(16) CookedMeshHeader
+{
+    u32 myMagic{};
+    u32 myVersion{};
+    // Value of VertexFormat
+    u32 myVertexFormat{};
+    u32 myVertexStride{};
+    u32 myVertexCount{};
+    u32 myIndexCount{};
+    // 2 or 4 bytes, matches the index type the mesh is drawn with
+    u32 myIndexStride{};
+    u32 myPadding{};
+
+    // Byte ranges from the start of the file
+    u64 myVertexOffset{};
+    u64 myVertexSize{};
+    u64 myIndexOffset{};
+    u64 myIndexSize{};
+
+    Vec3 myBoundsMin{};
+    Vec3 myBoundsMax{};
+    Vec3 myBoundsCenter{};
+    float myBoundsRadius{};
+    Mat4 myDequantizeTransform{};
+};
+
+namespace CookedMesh
+{
+    // Checks the header and that every stream lies inside the blob, logs what is wrong with it
+    bool Validate(const u8* data, size_t size, const String& name);
+
+    bool Write(const String& filename, const CookedMeshHeader& header, const void* vertexData, const void* indexData);
+}
@@ -0,0 +1,168 @@
+#include "frustum_culling.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULL_SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULL_SIMD_WIDTH 4
+#else
+#define CULL_SIMD_WIDTH 1
+#endif
+
+void BoundingSphereSoA::Resize(u32 count)
+{
+    myCenterX.resize(count);
+    myCenterY.resize(count);
+    myCenterZ.resize(count);
+    myRadius.resize(count);
+}
+
+Frustum FrustumCulling::ExtractFrustum(const Mat4& viewProjection)
+{
+    // glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+    const Mat4 rows = glm::transpose(viewProjection);
+
+    Frustum frustum{};
+    frustum.myPlanes[0] = rows[3] + rows[0]; // left
+    frustum.myPlanes[1] = rows[3] - rows[0]; // right
+    frustum.myPlanes[2] = rows[3] + rows[1]; // bottom
+    frustum.myPlanes[3] = rows[3] - rows[1]; // top
+#if defined(GLM_FORCE_DEPTH_ZERO_TO_ONE)
+    frustum.myPlanes[4] = rows[2];           // near
+#else
+    frustum.myPlanes[4] = rows[3] + rows[2]; // near
+#endif
+    frustum.myPlanes[5] = rows[3] - rows[2]; // far
+
+    // Normalized planes give real distances, which the sphere radius is compared against
+    for (Vec4& plane : frustum.myPlanes)
+        plane /= glm::length(Vec3(plane));
+
+    return frustum;
+}
+
+static bool IsSphereVisible(const Frustum& frustum, float x, float y, float z, float radius)
+{
+    for (const Vec4& plane : frustum.myPlanes)
+    {
+        if (plane.x * x + plane.y * y + plane.z * z + plane.w <= -radius)
+            return false;
+    }
+    return true;
+}
+
+static u32 CullSpheresRange(const Frustum& frustum, const BoundingSphereSoA& spheres, u32 begin, u32 end, u32* outVisible, u32 visibleCount)
+{
+    for (u32 i = begin; i < end; ++i)
+    {
+        // Branchless append, the slot is simply overwritten when the sphere is culled
+        outVisible[visibleCount] = i;
+        visibleCount += IsSphereVisible(frustum, spheres.myCenterX[i], spheres.myCenterY[i], spheres.myCenterZ[i], spheres.myRadius[i]) ? 1 : 0;
+    }
+    return visibleCount;
+}
+
+u32 FrustumCulling::CullSpheresScalar(const Frustum& frustum, const BoundingSphereSoA& spheres, u32* outVisible)
+{
+    return CullSpheresRange(frustum, spheres, 0, spheres.GetCount(), outVisible, 0);
+}
+
+#if CULL_SIMD_WIDTH == 8
+
+u32 FrustumCulling::CullSpheres(const Frustum& frustum, const BoundingSphereSoA& spheres, u32* outVisible)
+{
+    const u32 count = spheres.GetCount();
+    const u32 simdCount = count & ~7u;
+
+    __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        planeX[p] = _mm256_set1_ps(frustum.myPlanes[p].x);
+        planeY[p] = _mm256_set1_ps(frustum.myPlanes[p].y);
+        planeZ[p] = _mm256_set1_ps(frustum.myPlanes[p].z);
+        planeW[p] = _mm256_set1_ps(frustum.myPlanes[p].w);
+    }
+
+    const __m256 zero = _mm256_setzero_ps();
+    u32 visibleCount = 0;
+    for (u32 i = 0; i < simdCount; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(&spheres.myCenterX[i]);
+        const __m256 y = _mm256_loadu_ps(&spheres.myCenterY[i]);
+        const __m256 z = _mm256_loadu_ps(&spheres.myCenterZ[i]);
+        const __m256 negativeRadius = _mm256_sub_ps(zero, _mm256_loadu_ps(&spheres.myRadius[i]));
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            __m256 distance = _mm256_add_ps(_mm256_mul_ps(planeX[p], x), planeW[p]);
+            distance = _mm256_add_ps(_mm256_mul_ps(planeY[p], y), distance);
+            distance = _mm256_add_ps(_mm256_mul_ps(planeZ[p], z), distance);
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GT_OQ));
+        }
+
+        const int mask = _mm256_movemask_ps(inside);
+        for (u32 lane = 0; lane < 8; ++lane)
+        {
+            outVisible[visibleCount] = i + lane;
+            visibleCount += (mask >> lane) & 1;
+        }
+    }
+
+    return CullSpheresRange(frustum, spheres, simdCount, count, outVisible, visibleCount);
+}
+
+#elif CULL_SIMD_WIDTH == 4
+
+u32 FrustumCulling::CullSpheres(const Frustum& frustum, const BoundingSphereSoA& spheres, u32* outVisible)
+{
+    const u32 count = spheres.GetCount();
+    const u32 simdCount = count & ~3u;
+
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        planeX[p] = _mm_set1_ps(frustum.myPlanes[p].x);
+        planeY[p] = _mm_set1_ps(frustum.myPlanes[p].y);
+        planeZ[p] = _mm_set1_ps(frustum.myPlanes[p].z);
+        planeW[p] = _mm_set1_ps(frustum.myPlanes[p].w);
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    u32 visibleCount = 0;
+    for (u32 i = 0; i < simdCount; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(&spheres.myCenterX[i]);
+        const __m128 y = _mm_loadu_ps(&spheres.myCenterY[i]);
+        const __m128 z = _mm_loadu_ps(&spheres.myCenterZ[i]);
+        const __m128 negativeRadius = _mm_sub_ps(zero, _mm_loadu_ps(&spheres.myRadius[i]));
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            __m128 distance = _mm_add_ps(_mm_mul_ps(planeX[p], x), planeW[p]);
+            distance = _mm_add_ps(_mm_mul_ps(planeY[p], y), distance);
+            distance = _mm_add_ps(_mm_mul_ps(planeZ[p], z), distance);
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negativeRadius));
+        }
+
+        const int mask = _mm_movemask_ps(inside);
+        for (u32 lane = 0; lane < 4; ++lane)
+        {
+            outVisible[visibleCount] = i + lane;
+            visibleCount += (mask >> lane) & 1;
+        }
+    }
+
+    return CullSpheresRange(frustum, spheres, simdCount, count, outVisible, visibleCount);
+}
+
+#else
+
+u32 FrustumCulling::CullSpheres(const Frustum& frustum, const BoundingSphereSoA& spheres, u32* outVisible)
+{
+    return CullSpheresScalar(frustum, spheres, outVisible);
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "odyssey/types.h"
+
+// Six normalized planes (xyz normal pointing inwards, w distance) in world space
+struct Frustum
+{
+    Vec4 myPlanes[6]{};
+};
+
+// World space bounding spheres as separate streams so four or eight of them fit one register
+struct BoundingSphereSoA
+{
+    Vector<float> myCenterX{};
+    Vector<float> myCenterY{};
+    Vector<float> myCenterZ{};
+    Vector<float> myRadius{};
+
+    void Resize(u32 count);
+    u32 GetCount() const { return static_cast<u32>(myRadius.size()); }
+
+    void Set(u32 index, const Vec3& center, float radius)
+    {
+        myCenterX[index] = center.x;
+        myCenterY[index] = center.y;
+        myCenterZ[index] = center.z;
+        myRadius[index] = radius;
+    }
+};
+
+namespace FrustumCulling
+{
+    // Gribb-Hartmann plane extraction, the planes are in the space the matrix transforms from
+    Frustum ExtractFrustum(const Mat4& viewProjection);
+
+    // Writes the indices of the spheres that intersect the frustum and returns how many there are.
+    // outVisible needs room for spheres.GetCount() indices. Uses AVX when the build enables it,
+    // SSE on other x86 builds and plain C++ everywhere else.
+    u32 CullSpheres(const Frustum& frustum, const BoundingSphereSoA& spheres, u32* outVisible);
+    u32 CullSpheresScalar(const Frustum& frustum, const BoundingSphereSoA& spheres, u32* outVisible);
+}
@@ -0,0 +1,239 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+
+// A dead end jump only starts a new cluster once the current one has at least this many
+// triangles, smaller clusters make the overdraw sort undo too much of the cache ordering
+constexpr u32 MIN_CLUSTER_TRIANGLES = 64;
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const u32* indices, size_t indexCount, u32 vertexCount, u32 cacheSize)
+{
+    VertexCacheStats stats{};
+    if (indexCount == 0 || vertexCount == 0)
+        return stats;
+
+    // A vertex is in a FIFO cache if fewer than cacheSize misses happened since it was pushed
+    Vector<u32> cacheTimestamps(vertexCount, 0);
+    u32 timestamp = cacheSize + 1;
+
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        const u32 index = indices[i];
+        if (timestamp - cacheTimestamps[index] > cacheSize)
+        {
+            cacheTimestamps[index] = timestamp++;
+            ++stats.myTransformedVertexCount;
+        }
+    }
+
+    stats.myACMR = static_cast<float>(stats.myTransformedVertexCount) / (indexCount / 3);
+    stats.myATVR = static_cast<float>(stats.myTransformedVertexCount) / vertexCount;
+    return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(u32* destination, const u32* indices, size_t indexCount, u32 vertexCount, u32 cacheSize, Vector<u32>* outClusters)
+{
+    const u32 triangleCount = static_cast<u32>(indexCount / 3);
+    if (outClusters)
+        outClusters->clear();
+    if (triangleCount == 0)
+        return;
+
+    // Vertex to triangle adjacency as offsets into one flat array
+    Vector<u32> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; ++i)
+        ++liveTriangles[indices[i]];
+
+    Vector<u32> adjacencyOffsets(vertexCount + 1, 0);
+    for (u32 v = 0; v < vertexCount; ++v)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+    Vector<u32> adjacency(indexCount);
+    {
+        Vector<u32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (u32 t = 0; t < triangleCount; ++t)
+        {
+            for (u32 k = 0; k < 3; ++k)
+                adjacency[fill[indices[t * 3 + k]]++] = t;
+        }
+    }
+
+    // Copy first, destination may alias the input
+    const Vector<u32> source(indices, indices + indexCount);
+
+    Vector<u32> cacheTimestamps(vertexCount, 0);
+    Vector<bool> isEmitted(triangleCount, false);
+    Vector<u32> deadEnds;
+    Vector<u32> candidates;
+    deadEnds.reserve(indexCount);
+    candidates.reserve(64);
+
+    u32 timestamp = cacheSize + 1;
+    u32 cursor = 0;
+    u32 outputIndex = 0;
+    u32 clusterStart = 0;
+    i64 fanningVertex = source[0];
+
+    if (outClusters)
+        outClusters->push_back(0);
+
+    while (fanningVertex >= 0)
+    {
+        candidates.clear();
+
+        // Emit every remaining triangle around the fanning vertex
+        const u32 fan = static_cast<u32>(fanningVertex);
+        for (u32 a = adjacencyOffsets[fan]; a < adjacencyOffsets[fan + 1]; ++a)
+        {
+            const u32 triangle = adjacency[a];
+            if (isEmitted[triangle])
+                continue;
+
+            for (u32 k = 0; k < 3; ++k)
+            {
+                const u32 v = source[triangle * 3 + k];
+                destination[outputIndex++] = v;
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                --liveTriangles[v];
+
+                if (timestamp - cacheTimestamps[v] > cacheSize)
+                    cacheTimestamps[v] = timestamp++;
+            }
+            isEmitted[triangle] = true;
+        }
+
+        // Prefer the candidate that will still be in the cache after its remaining triangles, oldest first
+        i64 next = -1;
+        i64 bestPriority = -1;
+        for (u32 v : candidates)
+        {
+            if (liveTriangles[v] == 0)
+                continue;
+
+            i64 priority = 0;
+            const i64 age = static_cast<i64>(timestamp) - cacheTimestamps[v];
+            if (age + 2 * static_cast<i64>(liveTriangles[v]) <= cacheSize)
+                priority = age;
+
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+
+        if (next < 0)
+        {
+            // Dead end, fall back to recently used vertices and then to input order
+            while (!deadEnds.empty() && next < 0)
+            {
+                const u32 v = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveTriangles[v] > 0)
+                    next = v;
+            }
+
+            while (next < 0 && cursor < vertexCount)
+            {
+                if (liveTriangles[cursor] > 0)
+                    next = cursor;
+                ++cursor;
+            }
+
+            if (next >= 0 && outClusters && (outputIndex - clusterStart) / 3 >= MIN_CLUSTER_TRIANGLES)
+            {
+                outClusters->push_back(outputIndex);
+                clusterStart = outputIndex;
+            }
+        }
+
+        fanningVertex = next;
+    }
+}
+
+void MeshOptimizer::OptimizeOverdraw(u32* indices, size_t indexCount, const Vector<u32>& clusters, const float* positions, size_t positionStride)
+{
+    if (clusters.size() < 2)
+        return;
+
+    const auto position = [positions, positionStride](u32 index)
+    {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const u8*>(positions) + index * positionStride);
+        return Vec3(p[0], p[1], p[2]);
+    };
+
+    struct Cluster
+    {
+        u32 myBegin{};
+        u32 myEnd{};
+        Vec3 myCentroid{};
+        Vec3 myNormal{};
+        float myScore{};
+    };
+
+    Vector<Cluster> sortedClusters(clusters.size());
+    Vec3 meshCentroid{};
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        Cluster& cluster = sortedClusters[c];
+        cluster.myBegin = clusters[c];
+        cluster.myEnd = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<u32>(indexCount);
+
+        // Area weighted centroid and normal, the length of the cross product is twice the area
+        float clusterArea = 0.0f;
+        for (u32 i = cluster.myBegin; i < cluster.myEnd; i += 3)
+        {
+            const Vec3 a = position(indices[i]);
+            const Vec3 b = position(indices[i + 1]);
+            const Vec3 c2 = position(indices[i + 2]);
+            const Vec3 normal = glm::cross(b - a, c2 - a);
+            const float area = glm::length(normal);
+
+            cluster.myCentroid += (a + b + c2) * (area / 3.0f);
+            cluster.myNormal += normal;
+            clusterArea += area;
+        }
+
+        meshCentroid += cluster.myCentroid;
+        meshArea += clusterArea;
+        if (clusterArea > 0.0f)
+            cluster.myCentroid /= clusterArea;
+    }
+
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    for (Cluster& cluster : sortedClusters)
+    {
+        const float normalLength = glm::length(cluster.myNormal);
+        cluster.myScore = normalLength > 0.0f ? glm::dot(cluster.myCentroid - meshCentroid, cluster.myNormal / normalLength) : 0.0f;
+    }
+
+    std::stable_sort(sortedClusters.begin(), sortedClusters.end(), [](const Cluster& lhs, const Cluster& rhs) { return lhs.myScore > rhs.myScore; });
+
+    const Vector<u32> source(indices, indices + indexCount);
+    u32 outputIndex = 0;
+    for (const Cluster& cluster : sortedClusters)
+    {
+        for (u32 i = cluster.myBegin; i < cluster.myEnd; ++i)
+            indices[outputIndex++] = source[i];
+    }
+}
+
+u32 MeshOptimizer::BuildVertexFetchRemap(u32* outRemap, const u32* indices, size_t indexCount, u32 vertexCount)
+{
+    std::fill(outRemap, outRemap + vertexCount, ~0u);
+
+    u32 nextVertex = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        u32& remapped = outRemap[indices[i]];
+        if (remapped == ~0u)
+            remapped = nextVertex++;
+    }
+
+    return nextVertex;
+}
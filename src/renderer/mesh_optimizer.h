@@ -0,0 +1,51 @@
+#pragma once
+
+#include "odyssey/types.h"
+
+struct VertexCacheStats
+{
+    u32 myTransformedVertexCount{};
+    // Average cache miss ratio, transformed vertices per triangle. 0.5 is the best a regular grid can get, 3 is the worst
+    float myACMR{};
+    // Average transformed vertex ratio, transformed vertices per vertex. 1 is optimal
+    float myATVR{};
+};
+
+// Index buffer optimizations that run on the CPU at load or cook time. All functions work on
+// triangle lists and only need the vertex count, except the overdraw pass which needs positions.
+namespace MeshOptimizer
+{
+    // Typical size of the post transform cache in vertices, the exact value matters little
+    constexpr u32 DEFAULT_CACHE_SIZE = 16;
+
+    // Simulates a FIFO post transform cache to measure an index order without a GPU
+    VertexCacheStats AnalyzeVertexCache(const u32* indices, size_t indexCount, u32 vertexCount, u32 cacheSize = DEFAULT_CACHE_SIZE);
+
+    // Tipsify (Sander et al. 2007). destination may alias indices. Writes the first index of every
+    // cluster the algorithm produced to outClusters when given, OptimizeOverdraw sorts those.
+    void OptimizeVertexCache(u32* destination, const u32* indices, size_t indexCount, u32 vertexCount, u32 cacheSize = DEFAULT_CACHE_SIZE, Vector<u32>* outClusters = nullptr);
+
+    // Orders clusters so that the ones facing outwards from the mesh center draw first, which
+    // lets early depth testing reject more of what is behind them. Keeps the order inside a cluster.
+    void OptimizeOverdraw(u32* indices, size_t indexCount, const Vector<u32>& clusters, const float* positions, size_t positionStride);
+
+    // Builds a remap table that puts vertices in the order the indices first use them. Unused vertices
+    // are mapped to ~0u. Returns the number of used vertices.
+    u32 BuildVertexFetchRemap(u32* outRemap, const u32* indices, size_t indexCount, u32 vertexCount);
+
+    template <typename T>
+    void RemapVertices(Vector<T>& vertices, Vector<u32>& indices, const Vector<u32>& remap, u32 usedVertexCount)
+    {
+        Vector<T> remapped(usedVertexCount);
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            if (remap[i] != ~0u)
+                remapped[remap[i]] = vertices[i];
+        }
+
+        for (u32& index : indices)
+            index = remap[index];
+
+        vertices.swap(remapped);
+    }
+}
@@ -0,0 +1,451 @@
+#include "obj_parser.h"
+
+#include "odyssey/core/job_system.h"
+#include "odyssey/platform/platform_layer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+struct ObjChunk
+{
+    const char* myBegin{};
+    const char* myEnd{};
+
+    u32 myPositionCount{};
+    u32 myNormalCount{};
+    u32 myTriangleCount{};
+
+    // Where the chunk writes to, prefix sums of the counts of the chunks before it
+    u32 myFirstPosition{};
+    u32 myFirstNormal{};
+    u32 myFirstTriangle{};
+
+    bool myIsSupported = true;
+};
+
+enum class ObjLineType
+{
+    Other,
+    Position,
+    Normal,
+    Face
+};
+
+static bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static bool IsDigit(char c)
+{
+    return static_cast<unsigned>(c - '0') < 10u;
+}
+
+static const char* SkipSpaces(const char* cursor, const char* end)
+{
+    while (cursor < end && IsSpace(*cursor))
+        ++cursor;
+    return cursor;
+}
+
+// Lines end at '\n', a '\r' right before it is left out
+static const char* FindLineEnd(const char* cursor, const char* end, const char*& outNextLine)
+{
+    const void* lineBreak = memchr(cursor, '\n', end - cursor);
+    const char* lineEnd = lineBreak ? static_cast<const char*>(lineBreak) : end;
+    outNextLine = lineBreak ? lineEnd + 1 : end;
+
+    if (lineEnd > cursor && lineEnd[-1] == '\r')
+        --lineEnd;
+    return lineEnd;
+}
+
+// tinyobjloader also breaks lines at a '\r' on its own, which FindLineEnd doesn't
+static bool HasLoneCarriageReturn(const char* cursor, const char* end)
+{
+    while (const void* found = memchr(cursor, '\r', end - cursor))
+    {
+        cursor = static_cast<const char*>(found) + 1;
+        if (cursor == end || *cursor != '\n')
+            return true;
+    }
+    return false;
+}
+
+// Moves cursor past the keyword of the line
+static ObjLineType GetLineType(const char*& cursor, const char* lineEnd)
+{
+    const size_t length = lineEnd - cursor;
+
+    if (length >= 2 && cursor[0] == 'v' && IsSpace(cursor[1]))
+    {
+        cursor += 2;
+        return ObjLineType::Position;
+    }
+
+    if (length >= 3 && cursor[0] == 'v' && cursor[1] == 'n' && IsSpace(cursor[2]))
+    {
+        cursor += 3;
+        return ObjLineType::Normal;
+    }
+
+    if (length >= 2 && cursor[0] == 'f' && IsSpace(cursor[1]))
+    {
+        cursor += 2;
+        return ObjLineType::Face;
+    }
+
+    return ObjLineType::Other;
+}
+
+static u32 CountFaceCorners(const char* cursor, const char* lineEnd)
+{
+    u32 count = 0;
+    while (true)
+    {
+        cursor = SkipSpaces(cursor, lineEnd);
+        if (cursor == lineEnd)
+            return count;
+
+        ++count;
+        while (cursor < lineEnd && !IsSpace(*cursor))
+            ++cursor;
+    }
+}
+
+// Same as atoi on the digits at cursor
+static i32 ParseInt(const char*& cursor, const char* end)
+{
+    bool isNegative = false;
+    if (cursor < end && (*cursor == '-' || *cursor == '+'))
+    {
+        isNegative = *cursor == '-';
+        ++cursor;
+    }
+
+    i32 value = 0;
+    while (cursor < end && IsDigit(*cursor))
+    {
+        value = value * 10 + (*cursor - '0');
+        ++cursor;
+    }
+
+    return isNegative ? -value : value;
+}
+
+static const char* SkipToSeparator(const char* cursor, const char* end)
+{
+    while (cursor < end && *cursor != '/' && !IsSpace(*cursor))
+        ++cursor;
+    return cursor;
+}
+
+// OBJ indices are one based, negative ones count back from the last element read so far
+static bool ResolveIndex(i32 index, u32 countSoFar, u32 totalCount, i32& outIndex)
+{
+    if (index == 0)
+        return false;
+
+    const i64 resolved = index > 0 ? static_cast<i64>(index) - 1 : static_cast<i64>(countSoFar) + index;
+    if (resolved < 0 || resolved >= totalCount)
+        return false;
+
+    outIndex = static_cast<i32>(resolved);
+    return true;
+}
+
+// v, v/vt, v//vn or v/vt/vn, texture coordinates are skipped
+static bool ParseFaceCorner(const char*& cursor, const char* lineEnd, u32 positionCount, u32 normalCount, const ObjData& data, ObjIndex& outIndex)
+{
+    const u32 totalPositions = static_cast<u32>(data.myPositions.size());
+    const u32 totalNormals = static_cast<u32>(data.myNormals.size());
+
+    outIndex.myNormal = -1;
+    if (!ResolveIndex(ParseInt(cursor, lineEnd), positionCount, totalPositions, outIndex.myPosition))
+        return false;
+
+    cursor = SkipToSeparator(cursor, lineEnd);
+    if (cursor == lineEnd || *cursor != '/')
+        return true;
+    ++cursor;
+
+    if (cursor == lineEnd || *cursor != '/')
+    {
+        // Only rejected when zero, like tinyobjloader does
+        if (ParseInt(cursor, lineEnd) == 0)
+            return false;
+
+        cursor = SkipToSeparator(cursor, lineEnd);
+        if (cursor == lineEnd || *cursor != '/')
+            return true;
+    }
+    ++cursor;
+
+    if (!ResolveIndex(ParseInt(cursor, lineEnd), normalCount, totalNormals, outIndex.myNormal))
+        return false;
+
+    cursor = SkipToSeparator(cursor, lineEnd);
+    return true;
+}
+
+static void CountChunk(ObjChunk& chunk)
+{
+    if (HasLoneCarriageReturn(chunk.myBegin, chunk.myEnd))
+    {
+        chunk.myIsSupported = false;
+        return;
+    }
+
+    const char* cursor = chunk.myBegin;
+    while (cursor < chunk.myEnd)
+    {
+        const char* nextLine;
+        const char* lineEnd = FindLineEnd(cursor, chunk.myEnd, nextLine);
+        const char* token = SkipSpaces(cursor, lineEnd);
+
+        switch (GetLineType(token, lineEnd))
+        {
+        case ObjLineType::Position:
+            ++chunk.myPositionCount;
+            break;
+        case ObjLineType::Normal:
+            ++chunk.myNormalCount;
+            break;
+        case ObjLineType::Face:
+        {
+            // Faces with less than three corners are skipped, polygons are left to tinyobjloader
+            const u32 cornerCount = CountFaceCorners(token, lineEnd);
+            if (cornerCount == 3)
+                ++chunk.myTriangleCount;
+            else if (cornerCount > 3)
+                chunk.myIsSupported = false;
+            break;
+        }
+        default:
+            break;
+        }
+
+        cursor = nextLine;
+    }
+}
+
+static void ParseChunk(ObjChunk& chunk, ObjData& data)
+{
+    u32 positionCount = chunk.myFirstPosition;
+    u32 normalCount = chunk.myFirstNormal;
+    ObjIndex* triangleIndex = data.myTriangleIndices.data() + chunk.myFirstTriangle * 3;
+
+    const char* cursor = chunk.myBegin;
+    while (cursor < chunk.myEnd)
+    {
+        const char* nextLine;
+        const char* lineEnd = FindLineEnd(cursor, chunk.myEnd, nextLine);
+        const char* token = SkipSpaces(cursor, lineEnd);
+
+        switch (GetLineType(token, lineEnd))
+        {
+        case ObjLineType::Position:
+        {
+            Vec3& position = data.myPositions[positionCount++];
+            position.x = ObjParser::ParseFloat(token, lineEnd);
+            position.y = ObjParser::ParseFloat(token, lineEnd);
+            position.z = ObjParser::ParseFloat(token, lineEnd);
+            break;
+        }
+        case ObjLineType::Normal:
+        {
+            Vec3& normal = data.myNormals[normalCount++];
+            normal.x = ObjParser::ParseFloat(token, lineEnd);
+            normal.y = ObjParser::ParseFloat(token, lineEnd);
+            normal.z = ObjParser::ParseFloat(token, lineEnd);
+            break;
+        }
+        case ObjLineType::Face:
+        {
+            // CountChunk made sure there are no more than three corners
+            ObjIndex corners[3];
+            u32 cornerCount = 0;
+            while ((token = SkipSpaces(token, lineEnd)) < lineEnd && cornerCount < 3)
+            {
+                if (!ParseFaceCorner(token, lineEnd, positionCount, normalCount, data, corners[cornerCount++]))
+                {
+                    chunk.myIsSupported = false;
+                    return;
+                }
+
+                // Anything but whitespace after a corner is malformed
+                if (token < lineEnd && !IsSpace(*token))
+                {
+                    chunk.myIsSupported = false;
+                    return;
+                }
+            }
+
+            if (cornerCount == 3)
+            {
+                std::copy(corners, corners + 3, triangleIndex);
+                triangleIndex += 3;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+        cursor = nextLine;
+    }
+}
+
+bool ObjParser::Parse(const char* data, size_t size, ObjData& outData)
+{
+    outData = {};
+
+    const u32 maxChunkCount = std::max(1u, JobSystem::GetThreadCount()) * CHUNKS_PER_THREAD;
+    const u32 chunkCount = static_cast<u32>(std::clamp<size_t>(size / MIN_CHUNK_SIZE, 1, maxChunkCount));
+
+    // Split at the first line break after every even split point
+    Vector<ObjChunk> chunks(chunkCount);
+    const char* end = data + size;
+    const char* chunkBegin = data;
+    for (u32 i = 0; i < chunkCount; ++i)
+    {
+        const char* chunkEnd = end;
+        if (i + 1 < chunkCount)
+        {
+            const char* splitPoint = std::max(chunkBegin, data + size / chunkCount * (i + 1));
+            const void* lineBreak = memchr(splitPoint, '\n', end - splitPoint);
+            chunkEnd = lineBreak ? static_cast<const char*>(lineBreak) + 1 : end;
+        }
+
+        chunks[i].myBegin = chunkBegin;
+        chunks[i].myEnd = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    JobSystem::ParallelFor(chunkCount, 1, [&chunks](u32 begin, u32 end)
+    {
+        for (u32 i = begin; i < end; ++i)
+            CountChunk(chunks[i]);
+    });
+
+    u32 positionCount = 0;
+    u32 normalCount = 0;
+    u32 triangleCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        if (!chunk.myIsSupported)
+            return false;
+
+        chunk.myFirstPosition = positionCount;
+        chunk.myFirstNormal = normalCount;
+        chunk.myFirstTriangle = triangleCount;
+        positionCount += chunk.myPositionCount;
+        normalCount += chunk.myNormalCount;
+        triangleCount += chunk.myTriangleCount;
+    }
+
+    outData.myPositions.resize(positionCount);
+    outData.myNormals.resize(normalCount);
+    outData.myTriangleIndices.resize(static_cast<size_t>(triangleCount) * 3);
+
+    JobSystem::ParallelFor(chunkCount, 1, [&chunks, &outData](u32 begin, u32 end)
+    {
+        for (u32 i = begin; i < end; ++i)
+            ParseChunk(chunks[i], outData);
+    });
+
+    for (const ObjChunk& chunk : chunks)
+    {
+        if (!chunk.myIsSupported)
+            return false;
+    }
+
+    return true;
+}
+
+bool ObjParser::ParseFile(const String& filename, ObjData& outData)
+{
+    MappedFile file{};
+    if (!PlatformLayer::MapFile(filename, file))
+        return false;
+
+    const bool success = Parse(reinterpret_cast<const char*>(file.myData), file.mySize, outData);
+    PlatformLayer::UnmapFile(file);
+    return success;
+}
+
+float ObjParser::ParseFloat(const char*& cursor, const char* end)
+{
+    const char* current = SkipSpaces(cursor, end);
+    const char* tokenEnd = current;
+    while (tokenEnd < end && !IsSpace(*tokenEnd) && *tokenEnd != '\r')
+        ++tokenEnd;
+    cursor = tokenEnd;
+
+    if (current == tokenEnd)
+        return 0.0f;
+
+    double sign = 1.0;
+    if (*current == '+' || *current == '-')
+    {
+        sign = *current == '-' ? -1.0 : 1.0;
+        ++current;
+    }
+
+    // Integer part, which may be left out when the number starts with the decimal point
+    double mantissa = 0.0;
+    if (current == tokenEnd || *current != '.')
+    {
+        const char* digitsBegin = current;
+        while (current < tokenEnd && IsDigit(*current))
+        {
+            mantissa *= 10;
+            mantissa += static_cast<int>(*current - '0');
+            ++current;
+        }
+
+        if (current == digitsBegin)
+            return 0.0f;
+    }
+
+    if (current < tokenEnd && *current == '.')
+    {
+        static const double powers[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+        constexpr int powerCount = sizeof(powers) / sizeof(powers[0]);
+
+        ++current;
+        for (int digit = 1; current < tokenEnd && IsDigit(*current); ++digit, ++current)
+            mantissa += static_cast<int>(*current - '0') * (digit < powerCount ? powers[digit] : std::pow(10.0, -digit));
+    }
+
+    int exponent = 0;
+    if (current < tokenEnd && (*current == 'e' || *current == 'E'))
+    {
+        ++current;
+
+        bool isNegativeExponent = false;
+        if (current < tokenEnd && (*current == '+' || *current == '-'))
+        {
+            isNegativeExponent = *current == '-';
+            ++current;
+        }
+
+        const char* digitsBegin = current;
+        while (current < tokenEnd && IsDigit(*current))
+        {
+            exponent = exponent * 10 + (*current - '0');
+            ++current;
+        }
+
+        // An empty exponent makes the whole number invalid
+        if (current == digitsBegin)
+            return 0.0f;
+
+        if (isNegativeExponent)
+            exponent = -exponent;
+    }
+
+    const double value = exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa;
+    return static_cast<float>(sign * value);
+}
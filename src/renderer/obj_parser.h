@@ -0,0 +1,40 @@
+#pragma once
+
+#include "odyssey/types.h"
+
+struct ObjIndex
+{
+    // Zero based, -1 when the face corner has no normal
+    i32 myPosition{};
+    i32 myNormal{};
+};
+
+struct ObjData
+{
+    Vector<Vec3> myPositions;
+    Vector<Vec3> myNormals;
+    // Three per triangle, in file order
+    Vector<ObjIndex> myTriangleIndices;
+};
+
+// Multi threaded OBJ reader for large triangle meshes. The file is split into line aligned chunks
+// that are first counted and then parsed in parallel, each chunk writing straight to its spot in
+// the output found by prefix summing the counts, so nothing is merged or grown afterwards.
+//
+// Only reads positions, normals and triangles, the same things Mesh::LoadFromObj takes from
+// tinyobjloader, and produces bit identical results. Returns false for anything it doesn't handle
+// the same way, like polygons which tinyobjloader ear clips, so callers can fall back to it.
+namespace ObjParser
+{
+    // Chunks smaller than this aren't worth a job
+    constexpr size_t MIN_CHUNK_SIZE = 256 * 1024;
+    // More chunks than threads so that uneven chunks balance out
+    constexpr u32 CHUNKS_PER_THREAD = 4;
+
+    bool Parse(const char* data, size_t size, ObjData& outData);
+    bool ParseFile(const String& filename, ObjData& outData);
+
+    // Parses the float token at cursor and moves past it, 0 when it isn't a number. Does the exact
+    // same arithmetic as tinyobjloader, which is not correctly rounded, so that both agree bit for bit.
+    float ParseFloat(const char*& cursor, const char* end);
+}
@@ -0,0 +1,119 @@
+#include "range_allocator.h"
+
+#include "odyssey/core/assert.h"
+#include "odyssey/core/logger.h"
+
+void RangeAllocator::Initialize(u64 capacity)
+{
+    myCapacity = capacity;
+    Reset();
+}
+
+void RangeAllocator::Reset()
+{
+    myUsedSize = 0;
+    myFreeRanges.clear();
+    myFreeRangesBySize.clear();
+    myAllocations.clear();
+
+    if (myCapacity > 0)
+        AddFreeRange(0, myCapacity);
+}
+
+u64 RangeAllocator::Allocate(u64 size, u64 alignment)
+{
+    if (size == 0)
+        return INVALID_OFFSET;
+
+    // Smallest range first, alignment padding may push a request into a larger one
+    for (auto it = myFreeRangesBySize.lower_bound(size); it != myFreeRangesBySize.end(); ++it)
+    {
+        const u64 rangeOffset = it->second;
+        const u64 rangeSize = it->first;
+        const u64 offset = (rangeOffset + alignment - 1) / alignment * alignment;
+        const u64 padding = offset - rangeOffset;
+        if (padding + size > rangeSize)
+            continue;
+
+        RemoveFreeRange(myFreeRanges.find(rangeOffset));
+        if (padding > 0)
+            AddFreeRange(rangeOffset, padding);
+        if (padding + size < rangeSize)
+            AddFreeRange(offset + size, rangeSize - padding - size);
+
+        myAllocations[offset] = size;
+        myUsedSize += size;
+        return offset;
+    }
+
+    return INVALID_OFFSET;
+}
+
+void RangeAllocator::Free(u64 offset)
+{
+    const auto allocation = myAllocations.find(offset);
+    ASSERT_MSG(allocation != myAllocations.end(), "Freeing a range that was never allocated");
+    if (allocation == myAllocations.end())
+    {
+        Logger::LogError("Freeing a range at {} that was never allocated", offset);
+        return;
+    }
+
+    u64 size = allocation->second;
+    myAllocations.erase(allocation);
+    myUsedSize -= size;
+
+    // Merge with the free ranges right before and after it
+    const auto next = myFreeRanges.lower_bound(offset);
+    if (next != myFreeRanges.end() && next->first == offset + size)
+    {
+        size += next->second;
+        RemoveFreeRange(next);
+    }
+
+    const auto after = myFreeRanges.lower_bound(offset);
+    if (after != myFreeRanges.begin())
+    {
+        const auto previous = std::prev(after);
+        if (previous->first + previous->second == offset)
+        {
+            offset = previous->first;
+            size += previous->second;
+            RemoveFreeRange(previous);
+        }
+    }
+
+    AddFreeRange(offset, size);
+}
+
+RangeAllocatorStats RangeAllocator::GetStats() const
+{
+    RangeAllocatorStats stats{};
+    stats.myCapacity = myCapacity;
+    stats.myUsedSize = myUsedSize;
+    stats.myLargestFreeRange = myFreeRangesBySize.empty() ? 0 : myFreeRangesBySize.rbegin()->first;
+    stats.myAllocationCount = static_cast<u32>(myAllocations.size());
+    stats.myFreeRangeCount = static_cast<u32>(myFreeRanges.size());
+
+    const u64 freeSize = myCapacity - myUsedSize;
+    if (freeSize > 0)
+        stats.myFragmentation = 1.0f - static_cast<float>(static_cast<double>(stats.myLargestFreeRange) / freeSize);
+
+    return stats;
+}
+
+void RangeAllocator::AddFreeRange(u64 offset, u64 size)
+{
+    myFreeRanges[offset] = size;
+    myFreeRangesBySize.emplace(size, offset);
+}
+
+void RangeAllocator::RemoveFreeRange(FreeRangeIterator range)
+{
+    auto bySize = myFreeRangesBySize.lower_bound(range->second);
+    while (bySize->second != range->first)
+        ++bySize;
+
+    myFreeRangesBySize.erase(bySize);
+    myFreeRanges.erase(range);
+}
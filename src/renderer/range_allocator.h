@@ -0,0 +1,54 @@
+#pragma once
+
+#include <map>
+#include <unordered_map>
+
+#include "odyssey/types.h"
+
+struct RangeAllocatorStats
+{
+    u64 myCapacity{};
+    u64 myUsedSize{};
+    u64 myLargestFreeRange{};
+    u32 myAllocationCount{};
+    u32 myFreeRangeCount{};
+    // 0 while the free space is one range, towards 1 the more it is scattered over small ones
+    float myFragmentation{};
+};
+
+// Hands out ranges of an address space it doesn't own, like a GPU buffer. Free ranges are kept by
+// offset to merge them with their neighbours on Free and by size to allocate best fit, which keeps
+// the large ranges around for large requests.
+class RangeAllocator
+{
+public:
+    static constexpr u64 INVALID_OFFSET = ~0ull;
+
+    void Initialize(u64 capacity);
+    // Frees everything at once
+    void Reset();
+
+    // INVALID_OFFSET when no free range is large enough
+    u64 Allocate(u64 size, u64 alignment = 1);
+    void Free(u64 offset);
+
+    RangeAllocatorStats GetStats() const;
+    u64 GetCapacity() const { return myCapacity; }
+    u64 GetFreeSize() const { return myCapacity - myUsedSize; }
+
+private:
+    using FreeRangeIterator = std::map<u64, u64>::iterator;
+
+    void AddFreeRange(u64 offset, u64 size);
+    void RemoveFreeRange(FreeRangeIterator range);
+
+    u64 myCapacity{};
+    u64 myUsedSize{};
+
+    // Offset to size
+    std::map<u64, u64> myFreeRanges{};
+    // Size to offset, the same ranges again
+    std::multimap<u64, u64> myFreeRangesBySize{};
+    // Offset to size
+    std::unordered_map<u64, u64> myAllocations{};
+};
@@ -0,0 +1,101 @@
+#include "render_queue.h"
+
+#include "odyssey/core/assert.h"
+#include "odyssey/core/job_system.h"
+
+#include <algorithm>
+
+constexpr u32 RADIX_BITS = 8;
+constexpr u32 RADIX_SIZE = 1 << RADIX_BITS;
+constexpr u32 RADIX_PASSES = 64 / RADIX_BITS;
+
+u64 RenderSortKey::Make(u32 pass, u32 pipeline, u32 material, u32 mesh, float depth)
+{
+    constexpr u32 maxDepth = (1u << DEPTH_BITS) - 1;
+    const u32 quantizedDepth = static_cast<u32>(std::clamp(depth, 0.0f, 1.0f) * maxDepth);
+
+    // A masked id would share its key bits with another one and get drawn with its state
+    ASSERT_MSG(pass < (1u << PASS_BITS), "Render pass id doesn't fit the sort key");
+    ASSERT_MSG(pipeline < (1u << PIPELINE_BITS), "Pipeline id doesn't fit the sort key");
+    ASSERT_MSG(material < (1u << MATERIAL_BITS), "Material id doesn't fit the sort key");
+    ASSERT_MSG(mesh < (1u << MESH_BITS), "Mesh id doesn't fit the sort key");
+
+    return (static_cast<u64>(pass & ((1u << PASS_BITS) - 1)) << PASS_SHIFT)
+        | (static_cast<u64>(pipeline & ((1u << PIPELINE_BITS) - 1)) << PIPELINE_SHIFT)
+        | (static_cast<u64>(material & ((1u << MATERIAL_BITS) - 1)) << MATERIAL_SHIFT)
+        | (static_cast<u64>(mesh & ((1u << MESH_BITS) - 1)) << MESH_SHIFT)
+        | (static_cast<u64>(quantizedDepth) << DEPTH_SHIFT);
+}
+
+void RenderQueue::Sort()
+{
+    const u32 count = GetCount();
+    if (count < 2)
+        return;
+
+    // One chunk per thread, every chunk gets its own histogram so the scatter can run in parallel
+    const u32 chunkCount = count >= PARALLEL_SORT_THRESHOLD ? std::max(1u, JobSystem::GetThreadCount()) : 1;
+    const u32 chunkSize = (count + chunkCount - 1) / chunkCount;
+
+    myScratch.resize(count);
+    myHistograms.resize(chunkCount * RADIX_SIZE);
+
+    // A byte that is equal in all keys doesn't change the order, find those up front
+    u64 differingBits = 0;
+    const u64 firstKey = myEntries[0].myKey;
+    for (const RenderQueueEntry& entry : myEntries)
+        differingBits |= entry.myKey ^ firstKey;
+
+    RenderQueueEntry* source = myEntries.data();
+    RenderQueueEntry* destination = myScratch.data();
+
+    for (u32 pass = 0; pass < RADIX_PASSES; ++pass)
+    {
+        const u32 shift = pass * RADIX_BITS;
+        if (((differingBits >> shift) & (RADIX_SIZE - 1)) == 0)
+            continue;
+
+        JobSystem::ParallelFor(chunkCount, 1, [&](u32 begin, u32 end)
+        {
+            for (u32 chunk = begin; chunk < end; ++chunk)
+            {
+                u32* histogram = &myHistograms[chunk * RADIX_SIZE];
+                std::fill(histogram, histogram + RADIX_SIZE, 0);
+
+                const u32 chunkEnd = std::min(count, (chunk + 1) * chunkSize);
+                for (u32 i = chunk * chunkSize; i < chunkEnd; ++i)
+                    ++histogram[(source[i].myKey >> shift) & (RADIX_SIZE - 1)];
+            }
+        });
+
+        // Bucket major, chunk minor so that equal digits keep their relative order
+        u32 offset = 0;
+        for (u32 bucket = 0; bucket < RADIX_SIZE; ++bucket)
+        {
+            for (u32 chunk = 0; chunk < chunkCount; ++chunk)
+            {
+                u32& slot = myHistograms[chunk * RADIX_SIZE + bucket];
+                const u32 bucketCount = slot;
+                slot = offset;
+                offset += bucketCount;
+            }
+        }
+
+        JobSystem::ParallelFor(chunkCount, 1, [&](u32 begin, u32 end)
+        {
+            for (u32 chunk = begin; chunk < end; ++chunk)
+            {
+                u32* offsets = &myHistograms[chunk * RADIX_SIZE];
+
+                const u32 chunkEnd = std::min(count, (chunk + 1) * chunkSize);
+                for (u32 i = chunk * chunkSize; i < chunkEnd; ++i)
+                    destination[offsets[(source[i].myKey >> shift) & (RADIX_SIZE - 1)]++] = source[i];
+            }
+        });
+
+        std::swap(source, destination);
+    }
+
+    if (source != myEntries.data())
+        myEntries.swap(myScratch);
+}
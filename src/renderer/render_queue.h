@@ -0,0 +1,61 @@
+#pragma once
+
+#include "odyssey/types.h"
+
+// 64 bit sort key, most significant first:
+// | pass 4 | pipeline 12 | material 12 | mesh 16 | depth 20 |
+// Sorting by key groups draws by the state that is most expensive to change.
+namespace RenderSortKey
+{
+    constexpr u32 PASS_BITS = 4;
+    constexpr u32 PIPELINE_BITS = 12;
+    constexpr u32 MATERIAL_BITS = 12;
+    constexpr u32 MESH_BITS = 16;
+    constexpr u32 DEPTH_BITS = 20;
+
+    constexpr u32 DEPTH_SHIFT = 0;
+    constexpr u32 MESH_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+    constexpr u32 MATERIAL_SHIFT = MESH_SHIFT + MESH_BITS;
+    constexpr u32 PIPELINE_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+    constexpr u32 PASS_SHIFT = PIPELINE_SHIFT + PIPELINE_BITS;
+
+    static_assert(PASS_SHIFT + PASS_BITS == 64, "Sort key must use exactly 64 bits");
+
+    // Depth is normalized to [0, 1], nearer sorts first
+    u64 Make(u32 pass, u32 pipeline, u32 material, u32 mesh, float depth);
+
+    // Keys that only differ in depth can be drawn with the same state
+    inline bool HasSameState(u64 lhs, u64 rhs)
+    {
+        return (lhs >> MESH_SHIFT) == (rhs >> MESH_SHIFT);
+    }
+}
+
+struct RenderQueueEntry
+{
+    u64 myKey{};
+    u32 myIndex{};
+};
+
+// Collects the visible draws of a frame and sorts them by key. Large queues are radix
+// sorted in parallel on the job system, key bytes that are the same for every entry
+// are skipped.
+class RenderQueue
+{
+public:
+    static constexpr u32 PARALLEL_SORT_THRESHOLD = 16 * 1024;
+
+    void Clear() { myEntries.clear(); }
+    void Reserve(u32 count) { myEntries.reserve(count); }
+    void Push(u64 key, u32 index) { myEntries.push_back({ key, index }); }
+
+    void Sort();
+
+    u32 GetCount() const { return static_cast<u32>(myEntries.size()); }
+    const RenderQueueEntry* GetEntries() const { return myEntries.data(); }
+
+private:
+    Vector<RenderQueueEntry> myEntries{};
+    Vector<RenderQueueEntry> myScratch{};
+    Vector<u32> myHistograms{};
+};
@@ -1,10 +1,71 @@
 #pragma once
 
+#include <string>
+
+#include "odyssey/core/frame_pipeline.h"
+
 struct RendererBackendConfig
 {
     const char* myApplicationName{};
     int myWidth = 0;
     int myHeight = 0;
+
+    // Renders into offscreen images instead of a swapchain, needs no surface or display
+    bool myIsOffscreen = false;
+    int myOffscreenImageCount = 3;
+    // Written on shutdown with the last rendered offscreen image, .raw gives RGBA8 otherwise PPM
+    std::string myReadbackPath{};
+
+    // Quantized 16 byte vertices instead of 36 byte full precision ones
+    bool myUsePackedVertices = false;
+    // Culls and builds the draws in a compute pass and draws through indirect calls, see GPUCulling
+    bool myUseGPUDrivenRendering = false;
+    // Materials read their data through one descriptor indexed set and push constants, see BindlessTable
+    bool myUseBindless = false;
+    // Objects in the test scene, 0 keeps the default grid
+    int mySceneObjectCount = 0;
+    // Where the pipeline cache is kept between runs, next to the executable when empty
+    std::string myPipelineCachePath{};
+};
+
+// GPU time of a named scope in milliseconds over the frames kept in the profiler's history
+struct GPUScopeTiming
+{
+    std::string myName{};
+    float myLastTime{};
+    float myMinTime{};
+    float myAverageTime{};
+    float myMaxTime{};
+    u32 mySampleCount{};
+};
+
+// Counters for the last rendered frame
+struct RenderStats
+{
+    u32 myDrawCalls{};
+    u32 myInstanceCount{};
+    u32 myPipelineBinds{};
+    u32 myDescriptorSetBinds{};
+    u32 myVertexBufferBinds{};
+    u32 myCulledObjectCount{};
+    // Vertex and index bytes the draws fetch, counting each instance as reading its whole mesh once
+    u64 myGeometryBytesRead{};
+    // The part of those that crosses the bus from host visible memory instead of coming from VRAM
+    u64 myHostGeometryBytesRead{};
+    // Vertex and index bytes in use out of what the geometry pool has
+    u64 myGeometryPoolUsedBytes{};
+    u64 myGeometryPoolCapacity{};
+    // The worse of its vertex and index buffers, see RangeAllocatorStats
+    float myGeometryPoolFragmentation{};
+    // Draws recorded in parallel, 0 when they went straight into the primary command buffer
+    u32 mySecondaryCommandBufferCount{};
+    // Milliseconds each thread spent recording draws, indexed by job system thread with threads outside it last
+    Vector<float> myThreadRecordTimes{};
+    // Descriptor sets allocated during the frame and the pools behind every descriptor allocator
+    u32 myDescriptorSetAllocations{};
+    u32 myDescriptorPoolCount{};
+    // Empty when the device can't write timestamps on the graphics queue, see GPUProfiler
+    Vector<GPUScopeTiming> myGPUScopes{};
 };
 
 class RendererBackend
@@ -13,5 +74,6 @@ public:
     virtual ~RendererBackend() = default;
 
     virtual bool Initialize(const RendererBackendConfig& config) = 0;
-    virtual void Render() = 0;
+    virtual void Render(const RenderSnapshot& snapshot) = 0;
+    virtual RenderStats GetRenderStats() const = 0;
 };    
\ No newline at end of file
@@ -1,14 +1,19 @@
 #include "odyssey.h"
 
+#include "odyssey/platform/platform_layer.h"
+
 #include "renderer_frontend.h"
 #include "renderer_backend.h"
+#if USE_VULKAN
 #include "vulkan/vulkan_backend.h"
+#endif
 
 static RendererBackend* locBackend{};
 
 void RendererFrontend::Shutdown()
 {
     delete locBackend;
+    locBackend = nullptr;
 }
 
 bool RendererFrontend::Initialize(int width, int height)
@@ -17,15 +22,59 @@ bool RendererFrontend::Initialize(int width, int height)
     config.myApplicationName = "test";
     config.myWidth = width;
     config.myHeight = height;
+    config.myIsOffscreen = PlatformLayer::IsHeadless();
+
+    for (const std::string& arg : PlatformLayer::GetArgs())
+    {
+        if (arg == "--offscreen")
+            config.myIsOffscreen = true;
+        else if (arg.rfind("--offscreen-images=", 0) == 0)
+            config.myOffscreenImageCount = std::max(1, std::atoi(arg.c_str() + strlen("--offscreen-images=")));
+        else if (arg.rfind("--readback=", 0) == 0)
+            config.myReadbackPath = arg.substr(strlen("--readback="));
+        else if (arg == "--packed-vertices")
+            config.myUsePackedVertices = true;
+        else if (arg == "--gpu-driven")
+            config.myUseGPUDrivenRendering = true;
+        else if (arg == "--bindless")
+            config.myUseBindless = true;
+        else if (arg.rfind("--scene-objects=", 0) == 0)
+            config.mySceneObjectCount = std::max(0, std::atoi(arg.c_str() + strlen("--scene-objects=")));
+        else if (arg.rfind("--pipeline-cache=", 0) == 0)
+            config.myPipelineCachePath = arg.substr(strlen("--pipeline-cache="));
+    }
 #if USE_VULKAN
 	locBackend = new VulkanBackend();
-    locBackend->Initialize(config);
 #endif
+    if (!locBackend)
+    {
+        Logger::LogWarn("No renderer backend available, running without rendering");
+        return false;
+    }
+
+    if (!locBackend->Initialize(config))
+    {
+        Logger::LogError("Renderer backend failed to initialize");
+        delete locBackend;
+        locBackend = nullptr;
+        return false;
+    }
 	return true;    
 }
 
-bool RendererFrontend::Render()
+bool RendererFrontend::Render(const RenderSnapshot& snapshot)
 {
-    locBackend->Render();
+    if (!locBackend)
+        return false;
+
+    locBackend->Render(snapshot);
     return true;
 }
+
+RenderStats RendererFrontend::GetRenderStats()
+{
+    if (!locBackend)
+        return {};
+
+    return locBackend->GetRenderStats();
+}
@@ -1,10 +1,15 @@
 #pragma once
 
+struct RenderSnapshot;
+struct RenderStats;
+
 namespace RendererFrontend
 {
     bool Initialize(int width, int height);
     void Shutdown();
 
     void OnResize(int width, int height);
-    bool Render();
+    bool Render(const RenderSnapshot& snapshot);
+    // Not synchronized with the render thread, read it when no frame is in flight
+    RenderStats GetRenderStats();
 };    
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "vertex_packing.h"
+
+#include <algorithm>
+#include <cmath>
+
+u16 VertexPacking::QuantizeUnorm16(float value)
+{
+    return static_cast<u16>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+float VertexPacking::DequantizeUnorm16(u16 value)
+{
+    return value / 65535.0f;
+}
+
+i16 VertexPacking::QuantizeSnorm16(float value)
+{
+    return static_cast<i16>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+float VertexPacking::DequantizeSnorm16(i16 value)
+{
+    // -32768 and -32767 both map to -1, as the Vulkan spec does it
+    return std::max(value / 32767.0f, -1.0f);
+}
+
+u8 VertexPacking::QuantizeUnorm8(float value)
+{
+    return static_cast<u8>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+float VertexPacking::DequantizeUnorm8(u8 value)
+{
+    return value / 255.0f;
+}
+
+static float SignNotZero(float value)
+{
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+Vec2 VertexPacking::OctahedralEncode(const Vec3& normal)
+{
+    // Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half over the upper one
+    const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (length == 0.0f)
+        return Vec2(0.0f);
+
+    const Vec3 projected = normal / length;
+    if (projected.z >= 0.0f)
+        return Vec2(projected.x, projected.y);
+
+    return Vec2((1.0f - std::abs(projected.y)) * SignNotZero(projected.x),
+                (1.0f - std::abs(projected.x)) * SignNotZero(projected.y));
+}
+
+Vec3 VertexPacking::OctahedralDecode(const Vec2& encoded)
+{
+    Vec3 normal(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+    const float fold = std::max(-normal.z, 0.0f);
+    normal.x += normal.x >= 0.0f ? -fold : fold;
+    normal.y += normal.y >= 0.0f ? -fold : fold;
+    return glm::normalize(normal);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "odyssey/types.h"
+
+// Conversions between floats and the normalized integer formats the GPU expands for free
+// when fetching vertices, UNORM maps to [0, 1] and SNORM to [-1, 1].
+namespace VertexPacking
+{
+    u16 QuantizeUnorm16(float value);
+    float DequantizeUnorm16(u16 value);
+
+    i16 QuantizeSnorm16(float value);
+    float DequantizeSnorm16(i16 value);
+
+    u8 QuantizeUnorm8(float value);
+    float DequantizeUnorm8(u8 value);
+
+    // Octahedral unit vector encoding (Meyer et al. 2010), two values in [-1, 1]
+    Vec2 OctahedralEncode(const Vec3& normal);
+    Vec3 OctahedralDecode(const Vec2& encoded);
+}
@@ -1,15 +1,18 @@
 #include "odyssey.h"
 
 #include "odyssey/platform/platform_layer.h"
+#include "odyssey/core/profiler.h"
 
 #include "vulkan_types.h"
 #include "vulkan_backend.h"
 #include "vulkan_initializers.h"
+#include "renderer/cooked_mesh.h"
 
 #define VMA_IMPLEMENTATION
 #include <vk_mem_alloc.h>
 
 #include <fstream>
+#include <algorithm>
 
 // TODO move some of this stuff here to other files.. will be using this for the beginning
 
@@ -36,6 +39,18 @@ VKAPI_ATTR VkBool32 VKAPI_CALL VulkanDebugCallback(
     return VK_FALSE;
 }
 
+// The counters a stretch of draw recording produces
+static void AccumulateDrawStats(RenderStats& stats, const RenderStats& drawStats)
+{
+    stats.myDrawCalls += drawStats.myDrawCalls;
+    stats.myInstanceCount += drawStats.myInstanceCount;
+    stats.myPipelineBinds += drawStats.myPipelineBinds;
+    stats.myDescriptorSetBinds += drawStats.myDescriptorSetBinds;
+    stats.myVertexBufferBinds += drawStats.myVertexBufferBinds;
+    stats.myGeometryBytesRead += drawStats.myGeometryBytesRead;
+    stats.myHostGeometryBytesRead += drawStats.myHostGeometryBytesRead;
+}
+
 VulkanBackend::VulkanBackend()
 {
 
@@ -43,31 +58,73 @@ VulkanBackend::VulkanBackend()
 
 VulkanBackend::~VulkanBackend()
 {
+    if (!myDevice)
+    {
+        // Initialization failed before we got a device, only the instance may exist
+        if (myInstance)
+        {
+            vkDestroySurfaceKHR(myInstance, mySurface, nullptr);
+#if IS_DEBUG
+            vkb::destroy_debug_utils_messenger(myInstance, myDebugMessenger);
+#endif
+            vkDestroyInstance(myInstance, nullptr);
+        }
+        return;
+    }
+
+    // Load jobs write into the backend, they have to be done before anything goes away
+    JobSystem::Wait(myMeshLoadCounter);
     vkDeviceWaitIdle(myDevice);
 
-    vmaDestroyBuffer(myAllocator, mySceneParameterBuffer.myBuffer, mySceneParameterBuffer.myAllocation);
-    vmaDestroyBuffer(myAllocator, myMesh.myVertexBuffer.myBuffer, myMesh.myVertexBuffer.myAllocation);
+    if (myIsOffscreen && !myReadbackPath.empty() && myFrameNumber > 0)
+        WriteReadback(myReadbackPath);
+
+    vkDestroyFence(myDevice, myUploadContext.myUploadFence, nullptr);
+    vkDestroyCommandPool(myDevice, myUploadContext.myCommandPool, nullptr);
+    myStagingUploader.Destroy();
 
-    vkDestroyPipeline(myDevice, myTrianglePipeline, nullptr);
+    for (MeshLoadResult& result : myLoadedMeshes)
+        PlatformLayer::UnmapFile(result.myCookedFile);
+
+    myGeometryPool.Destroy();
+    myGPUCulling.Destroy();
+    myGPUProfiler.Destroy();
+
+    myPipelineRegistry.Destroy();
     vkDestroyPipelineLayout(myDevice, myTrianglePipelineLayout, nullptr);
+    // Written back to disk for the next run
+    myPipelineCache.Destroy();
+
+    if (myMaterialBuffer.myBuffer)
+    {
+        vmaUnmapMemory(myAllocator, myMaterialBuffer.myAllocation);
+        vmaDestroyBuffer(myAllocator, myMaterialBuffer.myBuffer, myMaterialBuffer.myAllocation);
+    }
+    myBindlessTable.Destroy();
 
-    vkDestroyDescriptorPool(myDevice, myDescriptorPool, nullptr);
-    vkDestroyDescriptorSetLayout(myDevice, myGlobalSetLayout, nullptr);
+    myDescriptorSetCache.Clear();
+    myDescriptorAllocator.Destroy();
+    // Every set layout, the global one included
+    myDescriptorLayoutCache.Destroy();
 
     for (int i = 0; i < FRAME_OVERLAP; ++i)
     {
-        const FrameData& frame = myFrames[i];
+        FrameData& frame = myFrames[i];
         vkDestroySemaphore(myDevice, frame.myPresentSemaphore, nullptr);
         vkDestroySemaphore(myDevice, frame.myRenderSemaphore, nullptr);
         vkDestroyFence(myDevice, frame.myRenderFence, nullptr);
         vkDestroyCommandPool(myDevice, frame.myCommandPool, nullptr);
-        vmaDestroyBuffer(myAllocator, frame.myCameraBuffer.myBuffer, frame.myCameraBuffer.myAllocation);
+        for (ThreadCommandPool& pool : frame.myThreadCommandPools)
+            vkDestroyCommandPool(myDevice, pool.myCommandPool, nullptr);
+        frame.myTransientAllocator.Destroy(myAllocator);
+        frame.myDescriptorAllocator.Destroy();
     }
 
     vmaDestroyImage(myAllocator, myDepthImage.myImage, myDepthImage.myAllocation);
     vkDestroyImageView(myDevice, myDepthImageView, nullptr);
 
-    vkDestroySwapchainKHR(myDevice, mySwapchain, nullptr);
+    if (mySwapchain)
+        vkDestroySwapchainKHR(myDevice, mySwapchain, nullptr);
     vkDestroyRenderPass(myDevice, myRenderPass, nullptr);
 
     for (int i = 0; i < myFramebuffers.size(); ++i)
@@ -76,10 +133,14 @@ VulkanBackend::~VulkanBackend()
         vkDestroyImageView(myDevice, mySwapchainImageViews[i], nullptr);
     }
 
+    for (const AllocatedImage& image : myOffscreenImages)
+        vmaDestroyImage(myAllocator, image.myImage, image.myAllocation);
+
     vmaDestroyAllocator(myAllocator);
 
 	vkDestroyDevice(myDevice, nullptr);
-    vkDestroySurfaceKHR(myInstance, mySurface, nullptr);
+    if (mySurface)
+        vkDestroySurfaceKHR(myInstance, mySurface, nullptr);
 #if IS_DEBUG
     vkb::destroy_debug_utils_messenger(myInstance, myDebugMessenger);
 #endif
@@ -88,6 +149,13 @@ VulkanBackend::~VulkanBackend()
 
 bool VulkanBackend::Initialize(const RendererBackendConfig& config)
 {
+    myIsOffscreen = config.myIsOffscreen;
+    myReadbackPath = config.myReadbackPath;
+    myVertexFormat = config.myUsePackedVertices ? VertexFormat::Packed : VertexFormat::Full;
+    myUseGPUDrivenRendering = config.myUseGPUDrivenRendering;
+    myUseBindless = config.myUseBindless;
+    mySceneObjectCount = config.mySceneObjectCount;
+
     if (!CreateInstance())
         return false;
 
@@ -104,14 +172,28 @@ bool VulkanBackend::Initialize(const RendererBackendConfig& config)
         return false;
 
     InitCommands();
+    myStagingUploader.Initialize(myDevice, myAllocator, myTransferQueue, myTransferQueueFamily, myGraphicsQueueFamily, STAGING_BUFFER_SIZE);
+    myGeometryPool.Initialize(myAllocator, GetVertexStride(myVertexFormat), GEOMETRY_POOL_VERTEX_COUNT, GEOMETRY_POOL_INDEX_SIZE);
     InitDefaultRenderPass();
     InitFramebuffers(config);
     InitSyncStructures();
     InitDescriptors();
+    myGPUProfiler.Initialize(myDevice, myGPUProperties, myTimestampValidBits, FRAME_OVERLAP);
+
+    const std::string pipelineCachePath = config.myPipelineCachePath.empty() ? PlatformLayer::GetBinPath() + "/pipeline_cache.bin" : config.myPipelineCachePath;
+    myPipelineCache.Initialize(myDevice, myGPUProperties, pipelineCachePath);
+    myPipelineRegistry.Initialize(myDevice, myPipelineCache.GetCache());
+
+    const u64 pipelineStart = PlatformLayer::GetTimeNanoseconds();
     InitPipelines();
+    if (myUseGPUDrivenRendering)
+        InitGPUCulling();
+    Logger::Log("Created pipelines in {:.3f} ms with a {} pipeline cache", (PlatformLayer::GetTimeNanoseconds() - pipelineStart) / 1000000.0, myPipelineCache.IsWarm() ? "warm" : "cold");
     LoadMeshes();
 
     InitScene();
+    if (myUseGPUDrivenRendering)
+        UploadSceneObjects();
 
     myIsInitialized = true;
 
@@ -130,6 +212,9 @@ void VulkanBackend::InitSyncStructures()
         VK_CHECK(vkCreateSemaphore(myDevice, &semaphoreInfo, nullptr, &frame.myPresentSemaphore));
         VK_CHECK(vkCreateSemaphore(myDevice, &semaphoreInfo, nullptr, &frame.myRenderSemaphore));
     }
+
+    const VkFenceCreateInfo uploadFenceInfo = VulkanInit::FenceCreateInfo();
+    VK_CHECK(vkCreateFence(myDevice, &uploadFenceInfo, nullptr, &myUploadContext.myUploadFence));
 }
 
 bool VulkanBackend::CreateInstance()
@@ -145,6 +230,7 @@ bool VulkanBackend::CreateInstance()
 
 	auto instanceReturn = instanceBuilder
 										.require_api_version(1,1,0)
+										.set_headless(myIsOffscreen)
 #if IS_DEBUG
 										.set_debug_callback(VulkanDebugCallback)
 										.request_validation_layers()
@@ -160,7 +246,8 @@ bool VulkanBackend::CreateInstance()
     myVKBInstance = instanceReturn.value();
 	myInstance = myVKBInstance.instance;
     myDebugMessenger = myVKBInstance.debug_messenger;
-	mySurface = PlatformLayer::GetVulkanSurface(myInstance);    
+    if (!myIsOffscreen)
+	    mySurface = PlatformLayer::GetVulkanSurface(myInstance);    
 
     return true;
 }
@@ -168,7 +255,71 @@ bool VulkanBackend::CreateInstance()
 bool VulkanBackend::CreateDevice()
 {
     vkb::PhysicalDeviceSelector physDeviceSelector(myVKBInstance);
-    const auto physDeviceReturn = physDeviceSelector.set_surface(mySurface).set_minimum_version(1, 1).select();
+    if (!myIsOffscreen)
+        physDeviceSelector.set_surface(mySurface);
+
+    physDeviceSelector.set_minimum_version(1, 1);
+
+    // Setting required features replaces the previous ones, so every optional path adds to these
+    VkPhysicalDeviceFeatures requiredFeatures{};
+
+    // Every visible object is its own indirect command with its own first instance, the count
+    // extension is optional and only saves drawing the unused end of the command lists
+    if (myUseGPUDrivenRendering)
+    {
+        VkPhysicalDeviceFeatures indirectFeatures = requiredFeatures;
+        indirectFeatures.multiDrawIndirect = VK_TRUE;
+        indirectFeatures.drawIndirectFirstInstance = VK_TRUE;
+        physDeviceSelector.add_desired_extension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+        vkb::PhysicalDeviceSelector indirectSelector = physDeviceSelector;
+        indirectSelector.set_required_features(indirectFeatures);
+        const auto indirectDeviceReturn = indirectSelector.select();
+        if (indirectDeviceReturn)
+        {
+            physDeviceSelector = indirectSelector;
+            requiredFeatures = indirectFeatures;
+        }
+        else
+        {
+            Logger::LogWarn("No GPU with multi draw indirect, falling back to CPU culling: {}", indirectDeviceReturn.error().message());
+            myUseGPUDrivenRendering = false;
+        }
+    }
+
+    // Arrays indexed with values from push constants, written while bound for slots no frame in flight uses
+    if (myUseBindless)
+    {
+        // Dynamically uniform indexing into the storage buffer array is a core feature, not part of the extension
+        VkPhysicalDeviceFeatures bindlessFeatures = requiredFeatures;
+        bindlessFeatures.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+
+        VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+        indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+        indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+        indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+
+        vkb::PhysicalDeviceSelector bindlessSelector = physDeviceSelector;
+        bindlessSelector.add_required_extension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        bindlessSelector.add_required_extension_features(indexingFeatures);
+        bindlessSelector.set_required_features(bindlessFeatures);
+        const auto bindlessDeviceReturn = bindlessSelector.select();
+        if (bindlessDeviceReturn)
+        {
+            physDeviceSelector = bindlessSelector;
+            requiredFeatures = bindlessFeatures;
+        }
+        else
+        {
+            Logger::LogWarn("No GPU with descriptor indexing, falling back to bound descriptors: {}", bindlessDeviceReturn.error().message());
+            myUseBindless = false;
+        }
+    }
+
+    const auto physDeviceReturn = physDeviceSelector.select();
 	if (!physDeviceReturn)
     {
 		Logger::LogError(physDeviceReturn.error().message());
@@ -190,35 +341,78 @@ bool VulkanBackend::CreateDevice()
     myPhysicalDeviceProperties = physicalDevice.properties;
 	myGraphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
     myGraphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
+
+    // A transfer only family maps to the copy engines and streams next to rendering without taking
+    // graphics queue time, failing that any family other than graphics, failing that graphics itself
+    const auto dedicatedTransferQueue = vkbDevice.get_dedicated_queue(vkb::QueueType::transfer);
+    const auto separateTransferQueue = vkbDevice.get_queue(vkb::QueueType::transfer);
+    if (dedicatedTransferQueue)
+    {
+        myTransferQueue = dedicatedTransferQueue.value();
+        myTransferQueueFamily = vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer).value();
+        Logger::Log("Uploading on dedicated transfer queue family {}", myTransferQueueFamily);
+    }
+    else if (separateTransferQueue)
+    {
+        myTransferQueue = separateTransferQueue.value();
+        myTransferQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::transfer).value();
+        Logger::Log("Uploading on transfer capable queue family {}", myTransferQueueFamily);
+    }
+    else
+    {
+        myTransferQueue = myGraphicsQueue;
+        myTransferQueueFamily = myGraphicsQueueFamily;
+        Logger::Log("No separate transfer queue family, uploading on the graphics queue");
+    }
+
     myGPUProperties = vkbDevice.physical_device.properties;
+    myTimestampValidBits = physicalDevice.get_queue_families()[myGraphicsQueueFamily].timestampValidBits;
     Logger::Log("GPU minimum aligment of {}", myGPUProperties.limits.minUniformBufferOffsetAlignment);
 
+    if (myUseGPUDrivenRendering)
+    {
+        const Vector<std::string> extensions = physicalDevice.get_extensions();
+        if (std::find(extensions.begin(), extensions.end(), VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) != extensions.end())
+            myDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(myDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+
+        Logger::Log("GPU driven rendering {} draw indirect count", myDrawIndexedIndirectCount ? "with" : "without");
+    }
+
     return true;
 }
 
 bool VulkanBackend::CreateSwapchain(const RendererBackendConfig& config)
 {
-    vkb::SwapchainBuilder swapchain_builder{ myPhysicalDevice, myDevice, mySurface };
-	const auto swapchainReturn = swapchain_builder
-		.use_default_format_selection()
-		.set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
-		.set_desired_extent(config.myWidth, config.myHeight)
-		.set_old_swapchain(mySwapchain)
-		.build();
-
-	if (!swapchainReturn) 
+    if (myIsOffscreen)
     {
-		Logger::LogError("{} {}", swapchainReturn.error().message(), swapchainReturn.vk_result());
-        return false;
-	}
-    vkDestroySwapchainKHR(myDevice, mySwapchain, nullptr);
+        if (!CreateOffscreenTargets(config))
+            return false;
+    }
+    else
+    {
+        vkb::SwapchainBuilder swapchain_builder{ myPhysicalDevice, myDevice, mySurface };
+        const auto swapchainReturn = swapchain_builder
+            .use_default_format_selection()
+            .set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
+            .set_desired_extent(config.myWidth, config.myHeight)
+            .set_old_swapchain(mySwapchain)
+            .build();
+
+        if (!swapchainReturn) 
+        {
+            Logger::LogError("{} {}", swapchainReturn.error().message(), swapchainReturn.vk_result());
+            return false;
+        }
+        vkDestroySwapchainKHR(myDevice, mySwapchain, nullptr);
+
+        vkb::Swapchain vkbSwapchain = swapchainReturn.value();
 
-    vkb::Swapchain vkbSwapchain = swapchainReturn.value();
+        mySwapchain = vkbSwapchain;
+        mySwapchainImageFormat = swapchainReturn->image_format;
+        mySwapchainImages = vkbSwapchain.get_images().value();
+        mySwapchainImageViews = vkbSwapchain.get_image_views().value();
+    }
 
-	mySwapchain = vkbSwapchain;
-    mySwapchainImageFormat = swapchainReturn->image_format;
-    mySwapchainImages = vkbSwapchain.get_images().value();
-    mySwapchainImageViews = vkbSwapchain.get_image_views().value();
     myWindowExtent.width = config.myWidth;
     myWindowExtent.height = config.myHeight;
 
@@ -246,6 +440,41 @@ bool VulkanBackend::CreateSwapchain(const RendererBackendConfig& config)
     return true;
 }
 
+bool VulkanBackend::CreateOffscreenTargets(const RendererBackendConfig& config)
+{
+    // RGBA8 so the readback can be written out without any swizzling
+    mySwapchainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+    const VkExtent3D extent = { static_cast<uint32_t>(config.myWidth), static_cast<uint32_t>(config.myHeight), 1 };
+    const VkImageCreateInfo imageInfo = VulkanInit::ImageCreateInfo(mySwapchainImageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, extent);
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    // Never fewer targets than frames in flight, otherwise two frames would render into the same image
+    const int imageCount = std::max(static_cast<int>(FRAME_OVERLAP), config.myOffscreenImageCount);
+    for (int i = 0; i < imageCount; ++i)
+    {
+        AllocatedImage image{};
+        if (vmaCreateImage(myAllocator, &imageInfo, &allocInfo, &image.myImage, &image.myAllocation, nullptr) != VK_SUCCESS)
+        {
+            Logger::LogError("Failed to create offscreen render target {}", i);
+            return false;
+        }
+
+        const VkImageViewCreateInfo viewInfo = VulkanInit::ImageViewCreateInfo(mySwapchainImageFormat, image.myImage, VK_IMAGE_ASPECT_COLOR_BIT);
+        VkImageView view{};
+        VK_CHECK(vkCreateImageView(myDevice, &viewInfo, nullptr, &view));
+
+        myOffscreenImages.push_back(image);
+        mySwapchainImages.push_back(image.myImage);
+        mySwapchainImageViews.push_back(view);
+    }
+
+    Logger::Log("Rendering offscreen into {} {}x{} images", imageCount, config.myWidth, config.myHeight);
+    return true;
+}
+
 AllocatedBuffer VulkanBackend::CreateBuffer(size_t size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage) const
 {
     VkBufferCreateInfo info{};
@@ -273,7 +502,19 @@ void VulkanBackend::InitCommands()
 
         VkCommandBufferAllocateInfo allocInfo = VulkanInit::CommandBufferAllocateBuffer(myFrames[i].myCommandPool);
         VK_CHECK(vkAllocateCommandBuffers(myDevice, &allocInfo, &myFrames[i].myMainCommandBuffer));
+
+        // Reset as a whole once the frame's fence signals, the secondary buffers are allocated as needed
+        const VkCommandPoolCreateInfo threadCreateInfo = VulkanInit::CommandPoolCreateInfo(myGraphicsQueueFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+        myFrames[i].myThreadCommandPools.resize(JobSystem::GetThreadCount() + 1);
+        for (ThreadCommandPool& pool : myFrames[i].myThreadCommandPools)
+            VK_CHECK(vkCreateCommandPool(myDevice, &threadCreateInfo, nullptr, &pool.myCommandPool));
     }
+
+    const VkCommandPoolCreateInfo uploadCreateInfo = VulkanInit::CommandPoolCreateInfo(myGraphicsQueueFamily);
+    VK_CHECK(vkCreateCommandPool(myDevice, &uploadCreateInfo, nullptr, &myUploadContext.myCommandPool));
+
+    VkCommandBufferAllocateInfo uploadAllocInfo = VulkanInit::CommandBufferAllocateBuffer(myUploadContext.myCommandPool);
+    VK_CHECK(vkAllocateCommandBuffers(myDevice, &uploadAllocInfo, &myUploadContext.myCommandBuffer));
 }
 
 void VulkanBackend::InitDefaultRenderPass()
@@ -286,7 +527,8 @@ void VulkanBackend::InitDefaultRenderPass()
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // Offscreen targets end up as copy sources for the readback instead of being presented
+    colorAttachment.finalLayout = myIsOffscreen ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
@@ -373,45 +615,48 @@ void VulkanBackend::InitFramebuffers(const RendererBackendConfig& config)
 
 void VulkanBackend::InitPipelines()
 {
-    PipelineBuilder pipelineBuilder{};
+    PROFILE_SCOPE("VulkanBackend::InitPipelines");
 
-    VertexInputDescription vertexDescription = Vertex::GetVertexInputDescription();
-    pipelineBuilder.myVertexInputInfo = VulkanInit::VertexInputStateCreateInfo();
-
-    pipelineBuilder.myVertexInputInfo.pVertexAttributeDescriptions = vertexDescription.myAttributes.data();
-    pipelineBuilder.myVertexInputInfo.vertexAttributeDescriptionCount = static_cast<int>(vertexDescription.myAttributes.size());
+    PipelineBuilder pipelineBuilder{};
 
-    pipelineBuilder.myVertexInputInfo.pVertexBindingDescriptions = vertexDescription.myBindings.data();
-    pipelineBuilder.myVertexInputInfo.vertexBindingDescriptionCount = static_cast<int>(vertexDescription.myBindings.size());
+    pipelineBuilder.myVertexInput = Vertex::GetVertexInputDescription(myVertexFormat);
 
     pipelineBuilder.myShaderStages.clear();
 
     const std::string binPath = PlatformLayer::GetBinPath();
 
     VkShaderModule triangleVertexShader{};
-    if (!LoadShaderModule(binPath + "/../odyssey/assets/shaders/triangle.vert.spv", &triangleVertexShader))
+    const char* vertexShaderName = myVertexFormat == VertexFormat::Packed ? "triangle_packed.vert.spv" : "triangle.vert.spv";
+    if (!LoadShaderModule(binPath + "/../odyssey/assets/shaders/" + vertexShaderName, &triangleVertexShader))
     {
         return;
     }
 
     VkShaderModule triangleFragShader{};
-    if (!LoadShaderModule(binPath + "/../odyssey/assets/shaders/triangle.frag.spv", &triangleFragShader))
+    const char* fragShaderName = myUseBindless ? "triangle_bindless.frag.spv" : "triangle.frag.spv";
+    if (!LoadShaderModule(binPath + "/../odyssey/assets/shaders/" + fragShaderName, &triangleFragShader))
     {
+        vkDestroyShaderModule(myDevice, triangleVertexShader, nullptr);
         return;
     }
 
-    VkPipelineLayoutCreateInfo pipelineInfo = VulkanInit::PipelineLayoutCreateInfo();
+    // Pipelines built from them may still be compiling long after this returns
+    myPipelineRegistry.AdoptShaderModule(triangleVertexShader);
+    myPipelineRegistry.AdoptShaderModule(triangleFragShader);
 
-	VkPushConstantRange pushConstant;
-	pushConstant.offset = 0;
-	pushConstant.size = sizeof(MeshPushConstants);
-	pushConstant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    VkPipelineLayoutCreateInfo pipelineInfo = VulkanInit::PipelineLayoutCreateInfo();
 
-	pipelineInfo.pPushConstantRanges = &pushConstant;
-	pipelineInfo.pushConstantRangeCount = 1;
+    // Bindless materials share one layout, they differ only in what is pushed per draw
+    const VkDescriptorSetLayout setLayouts[] = { myGlobalSetLayout, myBindlessTable.GetSetLayout() };
+    VkPushConstantRange pushConstants{};
+    pushConstants.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstants.offset = 0;
+    pushConstants.size = sizeof(BindlessPushConstants);
 
-    pipelineInfo.setLayoutCount = 1;
-    pipelineInfo.pSetLayouts = &myGlobalSetLayout;
+    pipelineInfo.setLayoutCount = myUseBindless ? 2 : 1;
+    pipelineInfo.pSetLayouts = setLayouts;
+    pipelineInfo.pushConstantRangeCount = myUseBindless ? 1 : 0;
+    pipelineInfo.pPushConstantRanges = &pushConstants;
 
     VK_CHECK(vkCreatePipelineLayout(myDevice, &pipelineInfo, nullptr, &myTrianglePipelineLayout));
 
@@ -441,95 +686,137 @@ void VulkanBackend::InitPipelines()
     pipelineBuilder.myPipelineLayout = myTrianglePipelineLayout;
     pipelineBuilder.myDepthStencil = VulkanInit::DepthStencilCreateInfo(true, true, VK_COMPARE_OP_LESS_OR_EQUAL);
 
-    myTrianglePipeline = pipelineBuilder.BuildPipeline(myDevice, myRenderPass);
-
-    CreateMaterial(myTrianglePipeline, myTrianglePipelineLayout, "default");
+    // Everything else falls back to this one while it compiles, so it has to be there from the start
+    const PipelineHandle defaultPipeline = myPipelineRegistry.Request(pipelineBuilder, myRenderPass, true);
+    myPipelineRegistry.SetFallback(defaultPipeline);
 
-    vkDestroyShaderModule(myDevice, triangleVertexShader, nullptr);
-    vkDestroyShaderModule(myDevice, triangleFragShader, nullptr);
+    CreateMaterial(defaultPipeline, myTrianglePipelineLayout, "default");
 }
 
 void VulkanBackend::InitDescriptors()
 {
-    Vector<VkDescriptorPoolSize> sizes =
-    {
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10 },
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 10 }
-    };
-
-    VkDescriptorPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.flags = 0;
-    poolInfo.maxSets = 10;
-    poolInfo.poolSizeCount = (uint32_t)sizes.size();
-    poolInfo.pPoolSizes = sizes.data();
-
-    vkCreateDescriptorPool(myDevice, &poolInfo, nullptr, &myDescriptorPool);
+    myDescriptorAllocator.Initialize(myDevice, DESCRIPTOR_SETS_PER_POOL);
+    myDescriptorLayoutCache.Initialize(myDevice);
+    myDescriptorSetCache.Initialize(myDevice, &myDescriptorAllocator);
 
+    // Both bindings point into the frame's transient buffer, the offsets are given at bind time
     //binding for camera data at 0
-    const VkDescriptorSetLayoutBinding cameraBind = VulkanInit::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+    const VkDescriptorSetLayoutBinding cameraBind = VulkanInit::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0);
     //binding for scene data at 1
     const VkDescriptorSetLayoutBinding sceneBind = VulkanInit::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1);
     const VkDescriptorSetLayoutBinding bindings[] = { cameraBind, sceneBind };
 
-    VkDescriptorSetLayoutCreateInfo setInfo{};
-    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    setInfo.bindingCount = 2;
-    setInfo.flags = 0;
-    setInfo.pBindings = bindings;
+    myGlobalSetLayout = myDescriptorLayoutCache.CreateLayout(bindings, 2);
 
-    vkCreateDescriptorSetLayout(myDevice, &setInfo, nullptr, &myGlobalSetLayout);
-
-    const size_t sceneParamBufferSize = FRAME_OVERLAP * PadUniformBufferSize(sizeof(GPUSceneData));
-
-    mySceneParameterBuffer = CreateBuffer(sceneParamBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    const VkBufferUsageFlags transientUsage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    const size_t transientAlignment = std::max(myGPUProperties.limits.minUniformBufferOffsetAlignment, myGPUProperties.limits.minStorageBufferOffsetAlignment);
 
     for (int i = 0; i < FRAME_OVERLAP; ++i)
     {
         FrameData& frame = myFrames[i];
-        frame.myCameraBuffer = CreateBuffer(sizeof(GPUCameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        frame.myTransientAllocator.Initialize(myAllocator, TRANSIENT_BUFFER_SIZE, transientAlignment, transientUsage);
+        frame.myDescriptorAllocator.Initialize(myDevice, FRAME_DESCRIPTOR_SETS_PER_POOL);
+
+        DescriptorBinding setBindings[2]{};
+        setBindings[0].myBinding = 0;
+        setBindings[0].myType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        setBindings[0].myBufferInfo = { frame.myTransientAllocator.GetBuffer(), 0, sizeof(GPUCameraData) };
+        setBindings[1].myBinding = 1;
+        setBindings[1].myType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        setBindings[1].myBufferInfo = { frame.myTransientAllocator.GetBuffer(), 0, sizeof(GPUSceneData) };
+
+        frame.myGlobalDescriptor = myDescriptorSetCache.GetSet(myGlobalSetLayout, setBindings, 2);
+    }
 
-        VkDescriptorSetAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        allocInfo.descriptorPool = myDescriptorPool;
-        allocInfo.descriptorSetCount = 1;
-        allocInfo.pSetLayouts = &myGlobalSetLayout;
-        vkAllocateDescriptorSets(myDevice, &allocInfo, &frame.myGlobalDescriptor);
+    if (myUseBindless)
+        InitBindless();
+}
 
-        VkDescriptorBufferInfo cameraInfo{};
-        cameraInfo.buffer = frame.myCameraBuffer.myBuffer;
-        cameraInfo.offset = 0;
-        cameraInfo.range = sizeof(GPUCameraData);
+void VulkanBackend::InitBindless()
+{
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
 
-        VkDescriptorBufferInfo sceneInfo;
-        sceneInfo.buffer = mySceneParameterBuffer.myBuffer;
-        sceneInfo.offset = 0;
-        sceneInfo.range = sizeof(GPUSceneData);
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &indexingProperties;
+    vkGetPhysicalDeviceProperties2(myPhysicalDevice, &properties);
 
-        const VkWriteDescriptorSet cameraWrite = VulkanInit::WriteDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frame.myGlobalDescriptor, &cameraInfo, 0);
-        const VkWriteDescriptorSet sceneWrite = VulkanInit::WriteDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, frame.myGlobalDescriptor, &sceneInfo, 1);
-        const VkWriteDescriptorSet setWrites[] = { cameraWrite,sceneWrite };
+    if (!myBindlessTable.Initialize(myDevice, indexingProperties))
+    {
+        Logger::LogWarn("Failed to create the bindless table, falling back to bound descriptors");
+        myBindlessTable.Destroy();
+        myUseBindless = false;
+        return;
+    }
+
+    // Written once per material when it is created, read by every draw through its index
+    myMaterialBuffer = CreateBuffer(MAX_MATERIALS * sizeof(GPUMaterialData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    vmaMapMemory(myAllocator, myMaterialBuffer.myAllocation, reinterpret_cast<void**>(&myMappedMaterials));
+    myMaterialBufferHandle = myBindlessTable.RegisterStorageBuffer(myMaterialBuffer.myBuffer, 0, VK_WHOLE_SIZE);
+
+    Logger::Log("Bindless materials, {} storage buffers, {} sampled images and {} samplers in the table",
+        myBindlessTable.GetCapacity(BindlessResourceType::StorageBuffer), myBindlessTable.GetCapacity(BindlessResourceType::SampledImage),
+        myBindlessTable.GetCapacity(BindlessResourceType::Sampler));
+}
+
+void VulkanBackend::InitGPUCulling()
+{
+    const std::string binPath = PlatformLayer::GetBinPath();
+
+    VkShaderModule cullShader{};
+    if (!LoadShaderModule(binPath + "/../odyssey/assets/shaders/cull.comp.spv", &cullShader))
+    {
+        Logger::LogWarn("Failed to load the culling shader, falling back to CPU culling");
+        myUseGPUDrivenRendering = false;
+        return;
+    }
 
-        vkUpdateDescriptorSets(myDevice, 2, setWrites, 0, nullptr);
+    if (!myGPUCulling.Initialize(myDevice, myAllocator, myPipelineCache.GetCache(), myDescriptorLayoutCache, cullShader, FRAME_OVERLAP, myDrawIndexedIndirectCount,
+        myGPUProperties.limits.maxDrawIndirectCount))
+    {
+        Logger::LogWarn("Failed to create the culling pipeline, falling back to CPU culling");
+        myGPUCulling.Destroy();
+        myUseGPUDrivenRendering = false;
     }
+
+    vkDestroyShaderModule(myDevice, cullShader, nullptr);
 }
 
 void VulkanBackend::InitScene()
 {
-    for (int x = -5; x <= 5; x++)
+    // A square grid around the origin, 11 by 11 unless the config asks for another count
+    const int objectCount = mySceneObjectCount > 0 ? mySceneObjectCount : 11 * 11;
+    const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(objectCount))));
+
+    myRenderables.reserve(objectCount);
+    for (int i = 0; i < objectCount; i++)
     {
-        for (int y = -5; y <= 5; y++)
-        {
-            RenderObject tri{};
-            tri.myMesh = GetMesh("monke");
-            tri.myMaterial = GetMaterial("default");
-            tri.myTransformMatrix = glm::translate(glm::mat4{ 1.0 }, glm::vec3(x * 5, 4, y * 5));
+        const int x = i / side - side / 2;
+        const int y = i % side - side / 2;
 
-            myRenderables.push_back(tri);
-        }
+        RenderObject tri{};
+        tri.myMesh = GetMesh("monke");
+        tri.myMaterial = GetMaterial("default");
+        tri.myTransformMatrix = glm::translate(glm::mat4{ 1.0 }, glm::vec3(x * 5, 4, y * 5));
+
+        myRenderables.push_back(tri);
     }
 }
 
+void VulkanBackend::UploadSceneObjects()
+{
+    Vector<GPUObjectData> objects(myRenderables.size());
+    for (size_t i = 0; i < myRenderables.size(); ++i)
+    {
+        objects[i].myTransform = myRenderables[i].myTransformMatrix;
+        objects[i].myMeshIndex = myRenderables[i].myMesh->myId;
+    }
+
+    myGPUCulling.SetObjects(myStagingUploader, objects, static_cast<u64>(myFrameNumber));
+    Logger::Log("Uploaded {} objects for GPU culling", objects.size());
+}
+
 bool VulkanBackend::LoadShaderModule(const std::string& filePath, VkShaderModule* outShaderModule) const
 {
     std::ifstream file(filePath, std::ios::ate | std::ios::binary);
@@ -558,12 +845,30 @@ bool VulkanBackend::LoadShaderModule(const std::string& filePath, VkShaderModule
     return true;
 }
 
-Material* VulkanBackend::CreateMaterial(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name)
+Material* VulkanBackend::CreateMaterial(PipelineHandle pipeline, VkPipelineLayout layout, const std::string& name, const GPUMaterialData& data)
 {
+    const auto existing = myMaterials.find(name);
+
     Material mat{};
-    mat.myPipeline = pipeline;
+    mat.myPipelineHandle = pipeline;
     mat.myPipelineLayout = layout;
+    mat.myId = existing != myMaterials.end() ? existing->second.myId : static_cast<u32>(myMaterials.size());
+    // Handles are already small and shared by materials with the same pipeline state
+    mat.myPipelineId = pipeline;
+    mat.myMaterialIndex = mat.myId < MAX_MATERIALS ? mat.myId : 0;
     myMaterials[name] = mat;
+
+    // Materials are only created before the first frame, nothing in flight reads the entry yet
+    if (myMappedMaterials && mat.myId < MAX_MATERIALS)
+    {
+        myMappedMaterials[mat.myId] = data;
+        vmaFlushAllocation(myAllocator, myMaterialBuffer.myAllocation, mat.myId * sizeof(GPUMaterialData), sizeof(GPUMaterialData));
+    }
+    else if (myMappedMaterials)
+    {
+        Logger::LogWarn("More than {} materials, {} is drawn with the default material's data", MAX_MATERIALS, name);
+    }
+
     return &myMaterials[name];
 }
 
@@ -595,9 +900,9 @@ size_t VulkanBackend::PadUniformBufferSize(size_t originalSize) const
     return alignedSize;
 }
 
-void VulkanBackend::DrawObjects(VkCommandBuffer cmd, RenderObject* first, int count)
+GPUCameraData VulkanBackend::ComputeCameraData() const
 {
-    const glm::vec3 camPos = { cos(PlatformLayer::GetTimeSinceStartup()) * 10,-6.f,sin(PlatformLayer::GetTimeSinceStartup()) * 10};
+    const glm::vec3 camPos = { cos(mySnapshot.mySimulationTime) * 10,-6.f,sin(mySnapshot.mySimulationTime) * 10};
     const glm::mat4 view = glm::translate(glm::mat4(1.f), camPos);
     glm::mat4 projection = glm::perspective(glm::radians(70.f), 1700.f / 900.f, 0.1f, 200.0f);
     projection[1][1] *= -1;
@@ -606,91 +911,652 @@ void VulkanBackend::DrawObjects(VkCommandBuffer cmd, RenderObject* first, int co
     camData.myProjection = projection;
     camData.myView = view;
     camData.myViewProjection = projection * view;
+    return camData;
+}
+
+bool VulkanBackend::WriteFrameUniforms(uint32_t* outUniformOffsets)
+{
+    TransientAllocator& transientAllocator = GetCurrentFrame().myTransientAllocator;
+    GPUCameraData* cameraData = transientAllocator.Allocate<GPUCameraData>(outUniformOffsets[0]);
+    GPUSceneData* sceneData = transientAllocator.Allocate<GPUSceneData>(outUniformOffsets[1]);
+    // The ring is full, the frame is drawn without objects rather than with bad offsets
+    if (!cameraData || !sceneData)
+        return false;
 
-    void* data;
-    vmaMapMemory(myAllocator, GetCurrentFrame().myCameraBuffer.myAllocation, &data);
-    memcpy(data, &camData, sizeof(GPUCameraData));
-    vmaUnmapMemory(myAllocator, GetCurrentFrame().myCameraBuffer.myAllocation);
+    *cameraData = ComputeCameraData();
 
     const float framed = (myFrameNumber / 120.f);
     mySceneParameters.myAmbientColor = { sin(framed),0,cos(framed),1 };
-    char* sceneData;
-    vmaMapMemory(myAllocator, mySceneParameterBuffer.myAllocation, (void**)&sceneData);
-    const int frameIndex = myFrameNumber % FRAME_OVERLAP;
-    sceneData += PadUniformBufferSize(sizeof(GPUSceneData)) * frameIndex;
-    memcpy(sceneData, &mySceneParameters, sizeof(GPUSceneData));
-    vmaUnmapMemory(myAllocator, mySceneParameterBuffer.myAllocation);
-
-    Mesh* lastMesh = nullptr;
-    Material* lastMaterial = nullptr;
-    for (int i = 0; i < count; i++)
-    {
-        RenderObject& object = first[i];
-        if (object.myMaterial != lastMaterial) {
+    *sceneData = mySceneParameters;
+    return true;
+}
 
-            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.myMaterial->myPipeline);
-            lastMaterial = object.myMaterial;
+void VulkanBackend::BindGlobalDescriptors(VkCommandBuffer cmd, VkPipelineLayout layout, const uint32_t* uniformOffsets) const
+{
+    const VkDescriptorSet sets[] = { myFrames[myFrameNumber % FRAME_OVERLAP].myGlobalDescriptor, myBindlessTable.GetSet() };
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, myUseBindless ? 2 : 1, sets, 2, uniformOffsets);
+}
+
+void VulkanBackend::PushMaterialConstants(VkCommandBuffer cmd, const Material& material) const
+{
+    if (!myUseBindless)
+        return;
+
+    BindlessPushConstants constants{};
+    constants.myMaterialBuffer = myMaterialBufferHandle;
+    constants.myMaterialIndex = material.myMaterialIndex;
+    vkCmdPushConstants(cmd, material.myPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+}
 
-            uint32_t uniformOffset = static_cast<uint32_t>(PadUniformBufferSize(sizeof(GPUSceneData)) * frameIndex);
-            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.myMaterial->myPipelineLayout, 0, 1, &GetCurrentFrame().myGlobalDescriptor, 1, &uniformOffset);
+void VulkanBackend::PrepareDraws(RenderObject* first, int count)
+{
+    PROFILE_SCOPE("VulkanBackend::PrepareDraws");
+
+    TransientAllocator& transientAllocator = GetCurrentFrame().myTransientAllocator;
+
+    myDrawObjects = first;
+    myDrawGroups.clear();
+    myDrawInstances = {};
+    if (!WriteFrameUniforms(myDrawUniformOffsets))
+        return;
+
+    const glm::mat4 viewProjection = ComputeCameraData().myViewProjection;
+
+    myWorldBounds.Resize(count);
+    for (int i = 0; i < count; ++i)
+    {
+        const RenderObject& object = first[i];
+        const MeshBounds& bounds = object.myMesh->myBounds;
+        const glm::mat4& transform = object.myTransformMatrix;
+
+        // A non uniform scale stretches the sphere by its largest axis
+        const float scale = std::sqrt(std::max({ glm::dot(Vec3(transform[0]), Vec3(transform[0])), glm::dot(Vec3(transform[1]), Vec3(transform[1])), glm::dot(Vec3(transform[2]), Vec3(transform[2])) }));
+        myWorldBounds.Set(i, Vec3(transform * Vec4(bounds.myCenter, 1.0f)), bounds.myRadius * scale);
+    }
+
+    myVisibleObjects.resize(count);
+    const Frustum frustum = FrustumCulling::ExtractFrustum(viewProjection);
+    const u32 visibleCount = FrustumCulling::CullSpheres(frustum, myWorldBounds, myVisibleObjects.data());
+    myRenderStats.myCulledObjectCount = count - visibleCount;
+
+    // Key by state and distance so that equal state is adjacent, each run becomes one instanced draw
+    constexpr u32 opaquePass = 0;
+    constexpr float farPlane = 200.0f;
+
+    myRenderQueue.Clear();
+    myRenderQueue.Reserve(visibleCount);
+    for (u32 visibleIndex = 0; visibleIndex < visibleCount; ++visibleIndex)
+    {
+        const u32 i = myVisibleObjects[visibleIndex];
+        const RenderObject& object = first[i];
+        // Still streaming in, it shows up in a later frame
+        if (!object.myMesh->myIsResident)
+            continue;
+
+        const float viewDepth = (viewProjection * object.myTransformMatrix[3]).w;
+        myRenderQueue.Push(RenderSortKey::Make(opaquePass, object.myMaterial->myPipelineId, object.myMaterial->myId, object.myMesh->myId, viewDepth / farPlane), i);
+    }
+    myRenderQueue.Sort();
+
+    const u32 drawCount = myRenderQueue.GetCount();
+    if (drawCount == 0)
+        return;
+
+    const RenderQueueEntry* entries = myRenderQueue.GetEntries();
+
+    // All transforms go into one block in draw order, a group draws from its first instance on
+    myDrawInstances = transientAllocator.Allocate(drawCount * sizeof(InstanceData));
+    InstanceData* instances = static_cast<InstanceData*>(myDrawInstances.myData);
+    if (!instances)
+        return;
+
+    for (u32 i = 0; i < drawCount; ++i)
+    {
+        const RenderObject& object = first[entries[i].myIndex];
+        if (object.myMesh->myVertexFormat == VertexFormat::Packed)
+            instances[i].myTransform = object.myTransformMatrix * object.myMesh->myDequantizeTransform;
+        else
+            instances[i].myTransform = object.myTransformMatrix;
+    }
+
+    // The key only holds the low bits of each id, so equal keys alone don't make equal state
+    auto isSameState = [first, entries](u32 lhs, u32 rhs)
+    {
+        const RenderObject& lhsObject = first[entries[lhs].myIndex];
+        const RenderObject& rhsObject = first[entries[rhs].myIndex];
+        return RenderSortKey::HasSameState(entries[lhs].myKey, entries[rhs].myKey)
+            && lhsObject.myMesh == rhsObject.myMesh && lhsObject.myMaterial == rhsObject.myMaterial;
+    };
+
+    u32 groupStart = 0;
+    while (groupStart < drawCount)
+    {
+        u32 groupEnd = groupStart + 1;
+        while (groupEnd < drawCount && isSameState(groupEnd, groupStart))
+            ++groupEnd;
+
+        myDrawGroups.push_back({ groupStart, groupEnd });
+        groupStart = groupEnd;
+    }
+}
+
+bool VulkanBackend::ShouldRecordInParallel() const
+{
+    return JobSystem::GetThreadCount() > 1 && myDrawGroups.size() >= 2 * MIN_DRAW_GROUPS_PER_CHUNK;
+}
+
+void VulkanBackend::DrawObjects(VkCommandBuffer cmd, VkFramebuffer framebuffer, bool recordInParallel)
+{
+    PROFILE_SCOPE("VulkanBackend::DrawObjects");
+
+    FrameData& frame = GetCurrentFrame();
+    const u32 groupCount = static_cast<u32>(myDrawGroups.size());
+
+    if (!recordInParallel)
+    {
+        ThreadCommandPool& pool = frame.myThreadCommandPools[GetRecordingThreadSlot()];
+        const u64 start = PlatformLayer::GetTimeNanoseconds();
+        RecordDrawGroups(cmd, 0, groupCount, myRenderStats);
+        pool.myRecordTime += PlatformLayer::GetTimeNanoseconds() - start;
+    }
+    else
+    {
+        // As many chunks as threads, each with enough groups to be worth a command buffer
+        const u32 chunkCount = std::min(JobSystem::GetThreadCount(), groupCount / MIN_DRAW_GROUPS_PER_CHUNK);
+        myChunkCommandBuffers.resize(chunkCount);
+        myChunkStats.assign(chunkCount, RenderStats{});
+
+        JobSystem::ParallelFor(chunkCount, 1, [this, &frame, framebuffer, groupCount, chunkCount](u32 begin, u32 end)
+        {
+            // Whichever thread runs the chunk records it from its own pool, so the pools need no locking
+            ThreadCommandPool& pool = frame.myThreadCommandPools[GetRecordingThreadSlot()];
+            for (u32 chunk = begin; chunk < end; ++chunk)
+            {
+                PROFILE_SCOPE("RecordDrawChunk");
+                const u64 start = PlatformLayer::GetTimeNanoseconds();
+
+                const VkCommandBuffer secondary = BeginSecondaryCommandBuffer(pool, framebuffer);
+                RecordDrawGroups(secondary, groupCount * chunk / chunkCount, groupCount * (chunk + 1) / chunkCount, myChunkStats[chunk]);
+                VK_CHECK(vkEndCommandBuffer(secondary));
+                myChunkCommandBuffers[chunk] = secondary;
+
+                pool.myRecordTime += PlatformLayer::GetTimeNanoseconds() - start;
+            }
+        });
+
+        vkCmdExecuteCommands(cmd, chunkCount, myChunkCommandBuffers.data());
+
+        for (const RenderStats& chunkStats : myChunkStats)
+            AccumulateDrawStats(myRenderStats, chunkStats);
+        myRenderStats.mySecondaryCommandBufferCount = chunkCount;
+    }
+
+    myRenderStats.myThreadRecordTimes.resize(frame.myThreadCommandPools.size());
+    for (size_t i = 0; i < frame.myThreadCommandPools.size(); ++i)
+        myRenderStats.myThreadRecordTimes[i] = frame.myThreadCommandPools[i].myRecordTime / 1000000.0f;
+}
+
+void VulkanBackend::RecordDrawGroups(VkCommandBuffer cmd, u32 groupBegin, u32 groupEnd, RenderStats& outStats)
+{
+    if (groupBegin >= groupEnd || !myDrawInstances.myData)
+        return;
+
+    const RenderQueueEntry* entries = myRenderQueue.GetEntries();
+
+    // Every mesh is in the geometry pool, only the index type can still change between draws. A
+    // secondary command buffer inherits no state, so each one binds everything it uses itself.
+    const VkBuffer vertexBuffers[] = { myGeometryPool.GetVertexBuffer(), myDrawInstances.myBuffer };
+    const VkDeviceSize vertexOffsets[] = { 0, myDrawInstances.myOffset };
+    vkCmdBindVertexBuffers(cmd, 0, 2, vertexBuffers, vertexOffsets);
+    ++outStats.myVertexBufferBinds;
+
+    VkIndexType lastIndexType = VK_INDEX_TYPE_MAX_ENUM;
+    VkPipeline lastPipeline = VK_NULL_HANDLE;
+    VkPipelineLayout lastLayout = VK_NULL_HANDLE;
+    const Material* lastMaterial = nullptr;
+    for (u32 group = groupBegin; group < groupEnd; ++group)
+    {
+        const u32 groupStart = myDrawGroups[group].myBegin;
+        const RenderObject& object = myDrawObjects[entries[groupStart].myIndex];
+
+        // The fallback while the material's own pipeline is compiling
+        const VkPipeline pipeline = myPipelineRegistry.GetPipeline(object.myMaterial->myPipelineHandle);
+        if (!pipeline)
+            continue;
+
+        if (pipeline != lastPipeline) {
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            lastPipeline = pipeline;
+            ++outStats.myPipelineBinds;
         }
 
-        MeshPushConstants constants;
-        constants.myRenderMatrix = object.myTransformMatrix;
+        if (object.myMaterial->myPipelineLayout != lastLayout) {
+            BindGlobalDescriptors(cmd, object.myMaterial->myPipelineLayout, myDrawUniformOffsets);
+            lastLayout = object.myMaterial->myPipelineLayout;
+            ++outStats.myDescriptorSetBinds;
+        }
 
-        vkCmdPushConstants(cmd, object.myMaterial->myPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MeshPushConstants), &constants);
+        // Bindless materials all share the layout above, switching between them is just a push
+        if (object.myMaterial != lastMaterial) {
+            PushMaterialConstants(cmd, *object.myMaterial);
+            lastMaterial = object.myMaterial;
+        }
 
-        if (object.myMesh != lastMesh) {
-            VkDeviceSize offset = 0;
-            vkCmdBindVertexBuffers(cmd, 0, 1, &object.myMesh->myVertexBuffer.myBuffer, &offset);
-            lastMesh = object.myMesh;
+        if (object.myMesh->myIndexType != lastIndexType) {
+            vkCmdBindIndexBuffer(cmd, myGeometryPool.GetIndexBuffer(), 0, object.myMesh->myIndexType);
+            lastIndexType = object.myMesh->myIndexType;
+            ++outStats.myVertexBufferBinds;
         }
 
-        vkCmdDraw(cmd, static_cast<uint32_t>(object.myMesh->myVertices.size()), 1, 0, 0);
+        const GeometryAllocation& geometry = object.myMesh->myGeometry;
+        const uint32_t indexSize = object.myMesh->myIndexType == VK_INDEX_TYPE_UINT16 ? sizeof(u16) : sizeof(u32);
+        const uint32_t instanceCount = myDrawGroups[group].myEnd - groupStart;
+        vkCmdDrawIndexed(cmd, object.myMesh->myIndexCount, instanceCount, geometry.myIndexOffset / indexSize, static_cast<int32_t>(geometry.myVertexOffset), groupStart);
+
+        ++outStats.myDrawCalls;
+        outStats.myInstanceCount += instanceCount;
+
+        const u64 geometryBytes = static_cast<u64>(object.myMesh->myVertexBufferSize + object.myMesh->myIndexBufferSize) * instanceCount;
+        outStats.myGeometryBytesRead += geometryBytes;
+        if (!object.myMesh->myIsDeviceLocal)
+            outStats.myHostGeometryBytesRead += geometryBytes;
+    }
+}
+
+VkCommandBuffer VulkanBackend::BeginSecondaryCommandBuffer(ThreadCommandPool& pool, VkFramebuffer framebuffer) const
+{
+    // Reused every time the frame comes around, the pool was reset as a whole
+    if (pool.myUsedCount == pool.myCommandBuffers.size())
+    {
+        const VkCommandBufferAllocateInfo allocInfo = VulkanInit::CommandBufferAllocateBuffer(pool.myCommandPool, 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+        VkCommandBuffer newBuffer{};
+        VK_CHECK(vkAllocateCommandBuffers(myDevice, &allocInfo, &newBuffer));
+        pool.myCommandBuffers.push_back(newBuffer);
     }
+
+    const VkCommandBuffer cmd = pool.myCommandBuffers[pool.myUsedCount++];
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = myRenderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = framebuffer;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+    VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+
+    return cmd;
+}
+
+u32 VulkanBackend::GetRecordingThreadSlot() const
+{
+    // Threads outside the job system, like the frame pipeline's render thread, share the last slot.
+    // Only the thread calling Render can be one of them.
+    const u32 threadIndex = JobSystem::GetThreadIndex();
+    return threadIndex < JobSystem::GetThreadCount() ? threadIndex : JobSystem::GetThreadCount();
+}
+
+void VulkanBackend::CullObjectsOnGPU(VkCommandBuffer cmd)
+{
+    PROFILE_SCOPE("VulkanBackend::CullObjectsOnGPU");
+    const GPUProfileScope profileScope(myGPUProfiler, cmd, "Cull");
+
+    // Indexed by mesh id, meshes that aren't resident yet have no indices and cull every object using them
+    myGPUMeshes.assign(myMeshes.size(), GPUMeshData{});
+    for (const auto& entry : myMeshes)
+    {
+        const Mesh& mesh = entry.second;
+        if (!mesh.myIsResident)
+            continue;
+
+        GPUMeshData& meshData = myGPUMeshes[mesh.myId];
+        if (mesh.myVertexFormat == VertexFormat::Packed)
+            meshData.myDequantizeTransform = mesh.myDequantizeTransform;
+        meshData.myBoundingSphere = Vec4(mesh.myBounds.myCenter, mesh.myBounds.myRadius);
+        meshData.myIndexCount = mesh.myIndexCount;
+
+        const uint32_t indexSize = mesh.myIndexType == VK_INDEX_TYPE_UINT16 ? sizeof(u16) : sizeof(u32);
+        meshData.myFirstIndex = mesh.myGeometry.myIndexOffset / indexSize;
+        meshData.myVertexOffset = static_cast<i32>(mesh.myGeometry.myVertexOffset);
+        meshData.myDrawList = mesh.myIndexType == VK_INDEX_TYPE_UINT16 ? GPUCulling::DRAW_LIST_UINT16 : GPUCulling::DRAW_LIST_UINT32;
+    }
+
+    const Frustum frustum = FrustumCulling::ExtractFrustum(ComputeCameraData().myViewProjection);
+    myGPUCulling.Cull(cmd, myFrameNumber % FRAME_OVERLAP, frustum, GetCurrentFrame().myTransientAllocator, GetCurrentFrame().myDescriptorAllocator, myGPUMeshes);
+}
+
+void VulkanBackend::DrawObjectsIndirect(VkCommandBuffer cmd)
+{
+    const Material* material = GetMaterial("default");
+    const VkPipeline pipeline = myPipelineRegistry.GetPipeline(material->myPipelineHandle);
+    if (!pipeline)
+        return;
+
+    uint32_t uniformOffsets[2]{};
+    if (!WriteFrameUniforms(uniformOffsets))
+        return;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    BindGlobalDescriptors(cmd, material->myPipelineLayout, uniformOffsets);
+    PushMaterialConstants(cmd, *material);
+    ++myRenderStats.myPipelineBinds;
+    ++myRenderStats.myDescriptorSetBinds;
+
+    const VkBuffer vertexBuffer = myGeometryPool.GetVertexBuffer();
+    const VkDeviceSize vertexOffset = 0;
+    vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer, &vertexOffset);
+
+    // Binds the instance buffer and an index buffer per draw list next to every indirect call
+    const u32 drawCalls = myGPUCulling.Draw(cmd, myFrameNumber % FRAME_OVERLAP, myGeometryPool.GetIndexBuffer());
+    myRenderStats.myDrawCalls += drawCalls;
+    myRenderStats.myVertexBufferBinds += 1 + (drawCalls > 0 ? 1 + drawCalls : 0);
 }
 
 void VulkanBackend::LoadMeshes()
 {
+    PROFILE_SCOPE("VulkanBackend::LoadMeshes");
+
     const std::string binPath = PlatformLayer::GetBinPath();
 
-    myMesh.LoadFromObj(binPath + "/../odyssey/assets_src/meshes/test/monkey_flat.obj");
+    // Cooked by tools/mesh_cooker (the cook_meshes target), the OBJ is only a fallback for when it hasn't been run
+    const char* cookedName = myVertexFormat == VertexFormat::Packed ? "monkey_flat.packed" : "monkey_flat";
+    RequestMesh("monke",
+        binPath + "/../odyssey/assets/meshes/test/" + cookedName + CookedMesh::EXTENSION,
+        binPath + "/../odyssey/assets_src/meshes/test/monkey_flat.obj");
+}
+
+Mesh* VulkanBackend::RequestMesh(const std::string& name, const std::string& cookedPath, const std::string& objPath)
+{
+    const auto inserted = myMeshes.emplace(name, Mesh{});
+    Mesh& mesh = inserted.first->second;
+    if (!inserted.second)
+        return &mesh;
+
+    mesh.myId = static_cast<u32>(myMeshes.size() - 1);
+
+    const u64 requestTime = PlatformLayer::GetTimeNanoseconds();
+    auto load = [this, name, cookedPath, objPath, requestTime]()
+    {
+        MeshLoadResult result{};
+        result.myName = name;
+        result.myRequestTime = requestTime;
+        LoadMeshData(result, cookedPath, objPath);
+
+        std::lock_guard<std::mutex> lock(myLoadedMeshesMutex);
+        myLoadedMeshes.push_back(std::move(result));
+    };
+
+    // Without workers a job only runs once somebody waits on it, so read it right away instead
+    if (JobSystem::GetThreadCount() > 1)
+        JobSystem::Run(myMeshLoadCounter, load);
+    else
+        load();
+
+    return &mesh;
+}
+
+void VulkanBackend::LoadMeshData(MeshLoadResult& result, const std::string& cookedPath, const std::string& objPath) const
+{
+    if (LoadCookedMesh(result, cookedPath))
+    {
+        result.myIsLoaded = true;
+        return;
+    }
+
+    Logger::LogWarn("No usable cooked mesh at {}, parsing the OBJ instead", cookedPath);
+
+    Mesh& mesh = result.myMesh;
+    if (!mesh.LoadFromObj(objPath))
+        return;
+
+    if (myVertexFormat == VertexFormat::Packed)
+    {
+        mesh.Pack();
+
+        const VertexPackingError error = mesh.MeasurePackingError();
+        Logger::Log("Packed vertices: position error max {:.6f} avg {:.6f}, normal error max {:.4f} avg {:.4f} degrees",
+            error.myMaxPositionError, error.myAveragePositionError, error.myMaxNormalError, error.myAverageNormalError);
+    }
+
+    result.myIsLoaded = true;
+}
+
+bool VulkanBackend::LoadCookedMesh(MeshLoadResult& result, const std::string& path) const
+{
+    MappedFile file{};
+    if (!PlatformLayer::MapFile(path, file))
+        return false;
+
+    if (!CookedMesh::Validate(file.myData, file.mySize, path))
+    {
+        PlatformLayer::UnmapFile(file);
+        return false;
+    }
+
+    const CookedMeshHeader& header = *reinterpret_cast<const CookedMeshHeader*>(file.myData);
+    if (header.myVertexFormat != static_cast<u32>(myVertexFormat))
+    {
+        Logger::LogWarn("{} was cooked for another vertex format", path);
+        PlatformLayer::UnmapFile(file);
+        return false;
+    }
+
+    // Vertices are copied into the pool as they are, so they have to be laid out the way it expects
+    if (header.myVertexStride != GetVertexStride(myVertexFormat) || header.myVertexStride != myGeometryPool.GetVertexStride())
+    {
+        Logger::LogWarn("{} has {} byte vertices, expected {}, it needs to be cooked again", path, header.myVertexStride, myGeometryPool.GetVertexStride());
+        PlatformLayer::UnmapFile(file);
+        return false;
+    }
+
+    // Stays mapped until the render thread has copied the streams into the staging ring
+    result.myMesh.SetFromCooked(header);
+    result.myCookedFile = file;
+
+    Logger::Log("Loaded cooked mesh {}: {} triangles, {} vertices", path, header.myIndexCount / 3, header.myVertexCount);
+    return true;
+}
+
+void VulkanBackend::UpdateMeshStreaming(VkCommandBuffer cmd)
+{
+    PROFILE_SCOPE("VulkanBackend::UpdateMeshStreaming");
+
+    Vector<MeshLoadResult> loadedMeshes;
+    {
+        std::lock_guard<std::mutex> lock(myLoadedMeshesMutex);
+        loadedMeshes.swap(myLoadedMeshes);
+    }
+
+    for (MeshLoadResult& result : loadedMeshes)
+    {
+        if (!result.myIsLoaded)
+        {
+            Logger::LogError("Failed to load mesh {}, it will not be drawn", result.myName);
+            continue;
+        }
+
+        Mesh& mesh = myMeshes[result.myName];
+        const u32 id = mesh.myId;
+        mesh = std::move(result.myMesh);
+        mesh.myId = id;
 
-    UploadMesh(myMesh);
+        const CookedMeshHeader* header = reinterpret_cast<const CookedMeshHeader*>(result.myCookedFile.myData);
+        const size_t vertexDataSize = header ? header->myVertexSize : mesh.GetVertexDataSize();
+        const size_t indexDataSize = header ? header->myIndexSize : mesh.GetIndexDataSize();
+        if (!AllocateMeshGeometry(cmd, mesh, vertexDataSize, indexDataSize))
+        {
+            Logger::LogError("Geometry pool is out of space for mesh {}, it will not be drawn", result.myName);
+            PlatformLayer::UnmapFile(result.myCookedFile);
+            continue;
+        }
+
+        u64 uploadSerial = 0;
+        if (header)
+        {
+            // Both streams are already in their GPU layout, the file is the only copy on the CPU side
+            const GeometryAllocation& geometry = mesh.myGeometry;
+            myStagingUploader.Upload(myGeometryPool.GetVertexBuffer(), static_cast<VkDeviceSize>(geometry.myVertexOffset) * myGeometryPool.GetVertexStride(), result.myCookedFile.myData + header->myVertexOffset, header->myVertexSize);
+            uploadSerial = myStagingUploader.Upload(myGeometryPool.GetIndexBuffer(), geometry.myIndexOffset, result.myCookedFile.myData + header->myIndexOffset, header->myIndexSize);
+            PlatformLayer::UnmapFile(result.myCookedFile);
+        }
+        else
+        {
+            uploadSerial = UploadMesh(mesh);
+        }
+
+        myStreamingMeshes.push_back({ &mesh, result.myName, uploadSerial, result.myRequestTime });
+    }
+
+    // Goes out without waiting, the copies land while the next frames render
+    myStagingUploader.Submit();
+    myStagingUploader.AcquireUploads(cmd);
+
+    if (myStreamingMeshes.empty())
+        return;
 
-    myMeshes["monke"] = myMesh;
+    const u64 acquiredSerial = myStagingUploader.GetAcquiredSerial();
+    const u64 now = PlatformLayer::GetTimeNanoseconds();
+    for (size_t i = 0; i < myStreamingMeshes.size();)
+    {
+        const StreamingMesh& streaming = myStreamingMeshes[i];
+        if (streaming.myUploadSerial > acquiredSerial)
+        {
+            ++i;
+            continue;
+        }
+
+        streaming.myMesh->myIsResident = true;
+        Logger::Log("Mesh {} resident {:.3f} ms after it was requested, frame {}", streaming.myName, (now - streaming.myRequestTime) / 1000000.0, myFrameNumber);
+
+        myStreamingMeshes[i] = std::move(myStreamingMeshes.back());
+        myStreamingMeshes.pop_back();
+    }
+
+    if (myStreamingMeshes.empty() && myMeshLoadCounter.IsDone())
+    {
+        const UploadStats& uploadStats = myStagingUploader.GetStats();
+        Logger::Log("Streaming idle, uploaded {:.2f} MB in {} copies and {} submits, {} staging stalls",
+            uploadStats.myUploadedBytes / (1024.0 * 1024.0), uploadStats.myCopyCount, uploadStats.mySubmitCount, uploadStats.myStallCount);
+
+        const GeometryPoolStats poolStats = myGeometryPool.GetStats();
+        Logger::Log("Geometry pool holds {} meshes, {} of {} vertices and {:.2f} of {:.2f} MB of indices used, largest free ranges {} vertices and {:.2f} MB",
+            poolStats.myVertexStats.myAllocationCount, poolStats.myVertexStats.myUsedSize, poolStats.myVertexStats.myCapacity,
+            poolStats.myIndexStats.myUsedSize / (1024.0 * 1024.0), poolStats.myIndexStats.myCapacity / (1024.0 * 1024.0),
+            poolStats.myVertexStats.myLargestFreeRange, poolStats.myIndexStats.myLargestFreeRange / (1024.0 * 1024.0));
+    }
 }
 
-void VulkanBackend::UploadMesh(Mesh& mesh)
+bool VulkanBackend::AllocateMeshGeometry(VkCommandBuffer cmd, Mesh& mesh, size_t vertexDataSize, size_t indexDataSize)
 {
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = mesh.myVertices.size() * sizeof(Vertex);
-    bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    const u32 vertexCount = static_cast<u32>(vertexDataSize / myGeometryPool.GetVertexStride());
+    const u32 indexSize = static_cast<u32>(indexDataSize);
 
-    VmaAllocationCreateInfo allocInfo = {};
-    allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    if (!myGeometryPool.Allocate(vertexCount, indexSize, mesh.myGeometry))
+    {
+        if (!myGeometryPool.CanFitAfterDefragment(vertexCount, indexSize))
+            return false;
 
-    VK_CHECK(vmaCreateBuffer(myAllocator, &bufferInfo, &allocInfo,
-        &mesh.myVertexBuffer.myBuffer,
-        &mesh.myVertexBuffer.myAllocation,
-        nullptr));
+        DefragmentGeometry(cmd);
+        if (!myGeometryPool.Allocate(vertexCount, indexSize, mesh.myGeometry))
+            return false;
+    }
 
-    void* data;
-    vmaMapMemory(myAllocator, mesh.myVertexBuffer.myAllocation, &data);
+    mesh.myVertexBufferSize = vertexDataSize;
+    mesh.myIndexBufferSize = indexDataSize;
+    mesh.myIsDeviceLocal = myGeometryPool.IsDeviceLocal();
+    return true;
+}
+
+void VulkanBackend::DefragmentGeometry(VkCommandBuffer cmd)
+{
+    const u64 start = PlatformLayer::GetTimeNanoseconds();
+
+    // Everything uploaded into the old buffers has to have landed and belong to this queue before it is copied
+    myStagingUploader.Flush();
+    myStagingUploader.AcquireUploads(cmd);
+
+    Vector<GeometryAllocation*> allocations;
+    for (auto& entry : myMeshes)
+    {
+        if (entry.second.myGeometry.myIsAllocated)
+            allocations.push_back(&entry.second.myGeometry);
+    }
+
+    const GeometryPoolStats before = myGeometryPool.GetStats();
+    myGeometryPool.Defragment(cmd, allocations, static_cast<u64>(myFrameNumber));
+    const GeometryPoolStats after = myGeometryPool.GetStats();
+
+    Logger::Log("Defragmented the geometry pool in {:.3f} ms, moved {:.2f} MB, vertex fragmentation {:.1f}% to {:.1f}%, index fragmentation {:.1f}% to {:.1f}%",
+        (PlatformLayer::GetTimeNanoseconds() - start) / 1000000.0, (after.myDefragmentedBytes - before.myDefragmentedBytes) / (1024.0 * 1024.0),
+        before.myVertexStats.myFragmentation * 100.0f, after.myVertexStats.myFragmentation * 100.0f,
+        before.myIndexStats.myFragmentation * 100.0f, after.myIndexStats.myFragmentation * 100.0f);
+}
 
-    memcpy(data, mesh.myVertices.data(), mesh.myVertices.size() * sizeof(Vertex));
+u64 VulkanBackend::UploadMesh(Mesh& mesh)
+{
+    const GeometryAllocation& geometry = mesh.myGeometry;
+    myStagingUploader.Upload(myGeometryPool.GetVertexBuffer(), static_cast<VkDeviceSize>(geometry.myVertexOffset) * myGeometryPool.GetVertexStride(), mesh.GetVertexData(), mesh.GetVertexDataSize());
 
-    vmaUnmapMemory(myAllocator, mesh.myVertexBuffer.myAllocation);
+    Vector<u8> indexData(mesh.GetIndexDataSize());
+    mesh.CopyIndexData(indexData.data());
+    return myStagingUploader.Upload(myGeometryPool.GetIndexBuffer(), geometry.myIndexOffset, indexData.data(), indexData.size());
 }
 
-void VulkanBackend::Render()
+void VulkanBackend::Render(const RenderSnapshot& snapshot)
 {
-    VK_CHECK(vkWaitForFences(myDevice, 1, &GetCurrentFrame().myRenderFence, true, 1000000000));
-    VK_CHECK(vkResetFences(myDevice, 1, &GetCurrentFrame().myRenderFence));
+    PROFILE_SCOPE("VulkanBackend::Render");
+
+    mySnapshot = snapshot;
+
+    {
+        PROFILE_SCOPE("WaitForFrameFence");
+        VK_CHECK(vkWaitForFences(myDevice, 1, &GetCurrentFrame().myRenderFence, true, 1000000000));
+        VK_CHECK(vkResetFences(myDevice, 1, &GetCurrentFrame().myRenderFence));
+    }
+
+    // The GPU is done with everything this frame slot allocated last time around
+    GetCurrentFrame().myTransientAllocator.Reset();
+    GetCurrentFrame().myDescriptorAllocator.Reset();
+    for (ThreadCommandPool& pool : GetCurrentFrame().myThreadCommandPools)
+    {
+        VK_CHECK(vkResetCommandPool(myDevice, pool.myCommandPool, 0));
+        pool.myUsedCount = 0;
+        pool.myRecordTime = 0;
+    }
+    // This slot's last frame is done, so are the ones before it that may still have read replaced geometry
+    if (myFrameNumber >= static_cast<int>(FRAME_OVERLAP))
+    {
+        myGeometryPool.ReleaseRetiredBuffers(static_cast<u64>(myFrameNumber - FRAME_OVERLAP));
+        myGPUCulling.ReleaseRetiredBuffers(static_cast<u64>(myFrameNumber - FRAME_OVERLAP));
+        myBindlessTable.ReleaseRetiredHandles(static_cast<u64>(myFrameNumber - FRAME_OVERLAP));
+    }
+    // Pipelines that finished compiling since last frame replace the fallback from here on
+    myPipelineRegistry.Update();
+
+    myRenderStats = {};
+    // Only known once the GPU is done, so these are from the frame that last used this slot
+    u32 gpuVisibleCount = 0;
+    if (myUseGPUDrivenRendering && myGPUCulling.ReadVisibleCount(myFrameNumber % FRAME_OVERLAP, gpuVisibleCount))
+    {
+        myRenderStats.myInstanceCount = gpuVisibleCount;
+        myRenderStats.myCulledObjectCount = myGPUCulling.GetObjectCount() - gpuVisibleCount;
+    }
+    const GeometryPoolStats poolStats = myGeometryPool.GetStats();
+    myRenderStats.myGeometryPoolUsedBytes = poolStats.myVertexStats.myUsedSize * poolStats.myVertexStride + poolStats.myIndexStats.myUsedSize;
+    myRenderStats.myGeometryPoolCapacity = poolStats.myVertexStats.myCapacity * poolStats.myVertexStride + poolStats.myIndexStats.myCapacity;
+    myRenderStats.myGeometryPoolFragmentation = std::max(poolStats.myVertexStats.myFragmentation, poolStats.myIndexStats.myFragmentation);
 
     uint32_t swapchainImageIndex = 0;
-    VK_CHECK(vkAcquireNextImageKHR(myDevice, mySwapchain, 1000000000, GetCurrentFrame().myPresentSemaphore, nullptr, &swapchainImageIndex));
+    if (myIsOffscreen)
+        swapchainImageIndex = static_cast<uint32_t>(myFrameNumber % mySwapchainImages.size());
+    else
+    {
+        PROFILE_SCOPE("AcquireNextImage");
+        VK_CHECK(vkAcquireNextImageKHR(myDevice, mySwapchain, 1000000000, GetCurrentFrame().myPresentSemaphore, nullptr, &swapchainImageIndex));
+    }
 
     VK_CHECK(vkResetCommandBuffer(GetCurrentFrame().myMainCommandBuffer, 0));
 
@@ -702,6 +1568,25 @@ void VulkanBackend::Render()
 
     VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
 
+    // Reads this slot's timings from its last use, the fence above makes sure they are there
+    myGPUProfiler.BeginFrame(cmd, myFrameNumber % FRAME_OVERLAP);
+    const u32 frameScope = myGPUProfiler.BeginScope(cmd, "Frame");
+
+    // Ownership acquires have to be outside the render pass
+    const u32 streamingScope = myGPUProfiler.BeginScope(cmd, "Streaming");
+    UpdateMeshStreaming(cmd);
+    myGPUProfiler.EndScope(cmd, streamingScope);
+
+    // Until the object buffer has landed the CPU path draws the same scene
+    const bool drawIndirect = myUseGPUDrivenRendering && myStagingUploader.GetAcquiredSerial() >= myGPUCulling.GetObjectSerial();
+    if (drawIndirect)
+        CullObjectsOnGPU(cmd);
+    else
+        PrepareDraws(myRenderables.data(), static_cast<int>(myRenderables.size()));
+
+    // The whole subpass is either recorded inline or made of secondary command buffers
+    const bool recordInParallel = !drawIndirect && ShouldRecordInParallel();
+
     VkClearValue clearColorValue{};
     float flash = abs(sin(myFrameNumber / 120.0f));
     clearColorValue.color = { { 0.0f, 0.0f, flash, 1.0f} };
@@ -722,27 +1607,54 @@ void VulkanBackend::Render()
     beginInfo.clearValueCount = 2;
     beginInfo.pClearValues = clearValues;
 
-    vkCmdBeginRenderPass(cmd, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    // Around the render pass rather than in it, a pass of secondary command buffers takes nothing else
+    const u32 mainPassScope = myGPUProfiler.BeginScope(cmd, "MainPass");
+    vkCmdBeginRenderPass(cmd, &beginInfo, recordInParallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
 
-    DrawObjects(cmd, myRenderables.data(), static_cast<uint32_t>(myRenderables.size()));
+    if (drawIndirect)
+        DrawObjectsIndirect(cmd);
+    else
+        DrawObjects(cmd, beginInfo.framebuffer, recordInParallel);
 
     vkCmdEndRenderPass(cmd);
+    myGPUProfiler.EndScope(cmd, mainPassScope);
 
+    myGPUProfiler.EndScope(cmd, frameScope);
     VK_CHECK(vkEndCommandBuffer(cmd));
 
+    const DescriptorAllocatorStats& descriptorStats = myDescriptorAllocator.GetStats();
+    const DescriptorAllocatorStats& frameDescriptorStats = GetCurrentFrame().myDescriptorAllocator.GetStats();
+    myRenderStats.myDescriptorSetAllocations = frameDescriptorStats.mySetCount;
+    myRenderStats.myDescriptorPoolCount = descriptorStats.myPoolCount;
+    for (const FrameData& frame : myFrames)
+        myRenderStats.myDescriptorPoolCount += frame.myDescriptorAllocator.GetStats().myPoolCount;
+
+    GetCurrentFrame().myTransientAllocator.Flush(myAllocator);
+
     VkSubmitInfo submit{};
     submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
     VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     submit.pWaitDstStageMask = &waitStage;
-    submit.waitSemaphoreCount = 1;
+    submit.waitSemaphoreCount = myIsOffscreen ? 0 : 1;
     submit.pWaitSemaphores = &GetCurrentFrame().myPresentSemaphore;
-    submit.signalSemaphoreCount = 1;
+    submit.signalSemaphoreCount = myIsOffscreen ? 0 : 1;
     submit.pSignalSemaphores = &GetCurrentFrame().myRenderSemaphore;
     submit.commandBufferCount = 1;
     submit.pCommandBuffers = &cmd;
 
-    VK_CHECK(vkQueueSubmit(myGraphicsQueue, 1, &submit, GetCurrentFrame().myRenderFence));
+    {
+        PROFILE_SCOPE("QueueSubmit");
+        VK_CHECK(vkQueueSubmit(myGraphicsQueue, 1, &submit, GetCurrentFrame().myRenderFence));
+    }
+
+    myLastImageIndex = swapchainImageIndex;
+
+    if (myIsOffscreen)
+    {
+        myFrameNumber++;
+        return;
+    }
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -752,59 +1664,117 @@ void VulkanBackend::Render()
     presentInfo.waitSemaphoreCount = 1;
     presentInfo.pImageIndices = &swapchainImageIndex;
 
-    VK_CHECK(vkQueuePresentKHR(myGraphicsQueue, &presentInfo));
+    {
+        PROFILE_SCOPE("QueuePresent");
+        VK_CHECK(vkQueuePresentKHR(myGraphicsQueue, &presentInfo));
+    }
 
     myFrameNumber++;
 }
 
-FrameData& VulkanBackend::GetCurrentFrame()
+void VulkanBackend::ImmediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function)
 {
-    return myFrames[myFrameNumber % FRAME_OVERLAP];
-}
+    VkCommandBuffer cmd = myUploadContext.myCommandBuffer;
 
-VkPipeline PipelineBuilder::BuildPipeline(VkDevice device, VkRenderPass pass) const
-{
-    VkPipelineViewportStateCreateInfo viewportState{};
-    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    VkCommandBufferBeginInfo cmdBeginInfo{};
+    cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-    viewportState.viewportCount = 1;
-    viewportState.pViewports = &myViewport;
-    viewportState.scissorCount = 1;
-    viewportState.pScissors = &myScissor;
+    VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+    function(cmd);
+    VK_CHECK(vkEndCommandBuffer(cmd));
+
+    VkSubmitInfo submit{};
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &cmd;
+
+    VK_CHECK(vkQueueSubmit(myGraphicsQueue, 1, &submit, myUploadContext.myUploadFence));
 
-    VkPipelineColorBlendStateCreateInfo colorBlending = {};
-    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    VK_CHECK(vkWaitForFences(myDevice, 1, &myUploadContext.myUploadFence, true, 9999999999));
+    VK_CHECK(vkResetFences(myDevice, 1, &myUploadContext.myUploadFence));
 
-    colorBlending.logicOpEnable = VK_FALSE;
-    colorBlending.logicOp = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &myColorBlendAttachment;
+    VK_CHECK(vkResetCommandPool(myDevice, myUploadContext.myCommandPool, 0));
+}
 
-    VkGraphicsPipelineCreateInfo pipelineInfo = {};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.pNext = nullptr;
+bool VulkanBackend::WriteReadback(const std::string& path)
+{
+    const uint32_t width = myWindowExtent.width;
+    const uint32_t height = myWindowExtent.height;
+    const size_t size = static_cast<size_t>(width) * height * 4;
 
-    pipelineInfo.stageCount = static_cast<uint32_t>(myShaderStages.size());
-    pipelineInfo.pStages = myShaderStages.data();
-    pipelineInfo.pVertexInputState = &myVertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &myInputAssembly;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &myRasterizer;
-    pipelineInfo.pMultisampleState = &myMultisampling;
-    pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.layout = myPipelineLayout;
-    pipelineInfo.renderPass = pass;
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-    pipelineInfo.pDepthStencilState = &myDepthStencil;
+    AllocatedBuffer readbackBuffer = CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
 
-    VkPipeline newPipeline{};
-    if (vkCreateGraphicsPipelines(
-        device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS)
+    VkImage image = mySwapchainImages[myLastImageIndex];
+    ImmediateSubmit([&](VkCommandBuffer cmd)
+    {
+        // The render pass left the image in TRANSFER_SRC, only the color writes need to be made visible
+        VkImageMemoryBarrier imageBarrier{};
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = image;
+        imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageBarrier.subresourceRange.levelCount = 1;
+        imageBarrier.subresourceRange.layerCount = 1;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+        VkBufferImageCopy region{};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { width, height, 1 };
+
+        vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer.myBuffer, 1, &region);
+
+        VkMemoryBarrier hostBarrier{};
+        hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+    });
+
+    const u8* pixels = nullptr;
+    vmaMapMemory(myAllocator, readbackBuffer.myAllocation, (void**)&pixels);
+    vmaInvalidateAllocation(myAllocator, readbackBuffer.myAllocation, 0, VK_WHOLE_SIZE);
+
+    std::ofstream file(path, std::ios::binary);
+    const bool isRaw = path.size() >= 4 && path.compare(path.size() - 4, 4, ".raw") == 0;
+    if (isRaw)
     {
-        Logger::LogError("Failed to create pipeline");
-        return VK_NULL_HANDLE;
+        file.write(reinterpret_cast<const char*>(pixels), size);
     }
+    else
+    {
+        file << "P6\n" << width << " " << height << "\n255\n";
+        for (size_t i = 0; i < size; i += 4)
+            file.write(reinterpret_cast<const char*>(pixels + i), 3);
+    }
+    const bool success = file.good();
+
+    vmaUnmapMemory(myAllocator, readbackBuffer.myAllocation);
+    vmaDestroyBuffer(myAllocator, readbackBuffer.myBuffer, readbackBuffer.myAllocation);
+
+    if (success)
+        Logger::Log("Wrote frame {} readback to {}", myFrameNumber - 1, path);
+    else
+        Logger::LogError("Failed to write readback to {}", path);
 
-    return newPipeline;
+    return success;
+}
+
+RenderStats VulkanBackend::GetRenderStats() const
+{
+    // Gathered here rather than every frame, nobody asks for them that often
+    RenderStats stats = myRenderStats;
+    myGPUProfiler.GetTimings(stats.myGPUScopes);
+    return stats;
+}
+
+FrameData& VulkanBackend::GetCurrentFrame()
+{
+    return myFrames[myFrameNumber % FRAME_OVERLAP];
 }
@@ -4,14 +4,44 @@
 #include <vulkan/vulkan.h>
 #include <vk_mem_alloc.h>
 #include <unordered_map>
+#include <functional>
+#include <mutex>
+
+#include "odyssey/core/job_system.h"
+#include "odyssey/platform/platform_layer.h"
 
 #include "renderer/renderer_backend.h"
+#include "renderer/render_queue.h"
+#include "renderer/frustum_culling.h"
 #include "VkBootstrap.h"
 #include "vulkan_mesh.h"
+#include "vulkan_transient_allocator.h"
+#include "vulkan_staging_uploader.h"
+#include "vulkan_geometry_pool.h"
+#include "vulkan_gpu_culling.h"
+#include "vulkan_pipeline_cache.h"
+#include "vulkan_pipeline_registry.h"
+#include "vulkan_descriptors.h"
+#include "vulkan_bindless.h"
+#include "vulkan_gpu_profiler.h"
 
 // TODO some of this stuff needs to be moved out
 
 constexpr uint32_t FRAME_OVERLAP = 2;
+// Below this many state groups per chunk a secondary command buffer costs more than it saves
+constexpr u32 MIN_DRAW_GROUPS_PER_CHUNK = 64;
+// Per frame in flight, holds the camera, scene and any other data that only lives for one frame
+constexpr size_t TRANSIENT_BUFFER_SIZE = 16 * 1024 * 1024;
+// Ring all mesh data goes through on its way to device local memory
+constexpr size_t STAGING_BUFFER_SIZE = 32 * 1024 * 1024;
+// Shared by every mesh, see GeometryPool
+constexpr u32 GEOMETRY_POOL_VERTEX_COUNT = 2 * 1024 * 1024;
+constexpr u32 GEOMETRY_POOL_INDEX_SIZE = 32 * 1024 * 1024;
+// Sets in the first descriptor pool of an allocator, later pools grow from there
+constexpr u32 DESCRIPTOR_SETS_PER_POOL = 64;
+constexpr u32 FRAME_DESCRIPTOR_SETS_PER_POOL = 16;
+// Entries in the bindless material buffer, indexed by Material::myId
+constexpr u32 MAX_MATERIALS = 1024;
 
 struct GPUCameraData
 {
@@ -29,16 +59,16 @@ struct GPUSceneData
     Vec4 mySunlightColor{};
 };
 
-struct MeshPushConstants
-{
-	Vec4 myData{};
-	Mat4 myRenderMatrix{};
-};
-
 struct Material
 {
-    VkPipeline myPipeline{};
+    // Resolved through the pipeline registry at draw time, the pipeline may still be compiling
+    PipelineHandle myPipelineHandle = PipelineRegistry::INVALID_HANDLE;
     VkPipelineLayout myPipelineLayout{};
+    // Small ids for render sort keys
+    u32 myId{};
+    u32 myPipelineId{};
+    // Entry in the bindless material buffer, the default material's once the buffer is full
+    u32 myMaterialIndex{};
 };
 
 struct RenderObject
@@ -48,21 +78,48 @@ struct RenderObject
     glm::mat4 myTransformMatrix{};
 };
 
-class PipelineBuilder
+struct UploadContext
 {
-public:
-    std::vector<VkPipelineShaderStageCreateInfo> myShaderStages;
-    VkPipelineVertexInputStateCreateInfo myVertexInputInfo;
-    VkPipelineInputAssemblyStateCreateInfo myInputAssembly;
-    VkViewport myViewport;
-    VkRect2D myScissor;
-    VkPipelineRasterizationStateCreateInfo myRasterizer;
-    VkPipelineColorBlendAttachmentState myColorBlendAttachment;
-    VkPipelineMultisampleStateCreateInfo myMultisampling;
-    VkPipelineLayout myPipelineLayout;
-    VkPipelineDepthStencilStateCreateInfo myDepthStencil;
-
-    VkPipeline BuildPipeline(VkDevice device, VkRenderPass pass) const;
+    VkFence myUploadFence{};
+    VkCommandPool myCommandPool{};
+    VkCommandBuffer myCommandBuffer{};
+};
+
+// A mesh read on a worker thread, waiting for the render thread to create its buffers and upload it
+struct MeshLoadResult
+{
+    std::string myName{};
+    Mesh myMesh{};
+    // Set when it came from a cooked file, its streams are uploaded straight from the mapping
+    MappedFile myCookedFile{};
+    u64 myRequestTime{};
+    bool myIsLoaded = false;
+};
+
+// Uploaded and waiting for the staging uploader to hand its buffers to the graphics queue
+struct StreamingMesh
+{
+    Mesh* myMesh{};
+    std::string myName{};
+    u64 myUploadSerial{};
+    u64 myRequestTime{};
+};
+
+// Secondary command buffers of one thread for one frame, only that thread records from it
+struct ThreadCommandPool
+{
+    VkCommandPool myCommandPool{};
+    Vector<VkCommandBuffer> myCommandBuffers{};
+    u32 myUsedCount{};
+    // Spent recording draws this frame, in nanoseconds
+    u64 myRecordTime{};
+};
+
+// A run of render queue entries with the same state, drawn as one instanced draw
+struct DrawGroup
+{
+    u32 myBegin{};
+    u32 myEnd{};
 };
 
 struct FrameData
@@ -72,8 +129,12 @@ struct FrameData
 
     VkCommandPool myCommandPool;
     VkCommandBuffer myMainCommandBuffer;
+    // One per job system thread plus one for the render thread when it is outside the job system
+    Vector<ThreadCommandPool> myThreadCommandPools;
 
-    AllocatedBuffer myCameraBuffer;
+    TransientAllocator myTransientAllocator;
+    // Sets that are only written for this frame, reset with the rest of the frame
+    DescriptorAllocator myDescriptorAllocator;
     VkDescriptorSet myGlobalDescriptor;
 };
 
@@ -89,6 +150,7 @@ public:
     bool CreateInstance();
     bool CreateDevice();
     bool CreateSwapchain(const RendererBackendConfig& config);
+    bool CreateOffscreenTargets(const RendererBackendConfig& config);
     AllocatedBuffer CreateBuffer(size_t size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage) const;
 
     void InitCommands();
@@ -96,26 +158,76 @@ public:
     void InitFramebuffers(const RendererBackendConfig& config);
     void InitPipelines();
     void InitDescriptors();
+    // The bindless table and the material buffer registered with it, turns bindless off on failure
+    void InitBindless();
+    void InitGPUCulling();
 
     void InitScene();
+    // Hands the scene's transforms and meshes to the GPU culling pass
+    void UploadSceneObjects();
 
     bool LoadShaderModule(const std::string& filePath, VkShaderModule* outShaderModule) const;
 
-    Material* CreateMaterial(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name);
+    Material* CreateMaterial(PipelineHandle pipeline, VkPipelineLayout layout, const std::string& name, const GPUMaterialData& data = {});
     Material* GetMaterial(const std::string& name);
     Mesh* GetMesh(const std::string& name);
     size_t PadUniformBufferSize(size_t originalSize) const;
 
-    void DrawObjects(VkCommandBuffer cmd, RenderObject* first, int count);
+    GPUCameraData ComputeCameraData() const;
+    // Camera and scene data into the frame's transient buffer, at the dynamic offsets of the global set,
+    // false when the buffer is full and nothing should be drawn this frame
+    bool WriteFrameUniforms(uint32_t* outUniformOffsets);
+    // The global set, and the bindless table after it in bindless mode
+    void BindGlobalDescriptors(VkCommandBuffer cmd, VkPipelineLayout layout, const uint32_t* uniformOffsets) const;
+    // Only does anything in bindless mode, where it replaces binding the material's descriptors
+    void PushMaterialConstants(VkCommandBuffer cmd, const Material& material) const;
+    // Culls, sorts and writes the instances, everything before recording that has to happen outside the render pass
+    void PrepareDraws(RenderObject* first, int count);
+    bool ShouldRecordInParallel() const;
+    // Records the prepared draws, split into secondary command buffers over the job system when
+    // recordInParallel is set, in which case the render pass has to have been begun for them
+    void DrawObjects(VkCommandBuffer cmd, VkFramebuffer framebuffer, bool recordInParallel);
+    // Safe to call from several threads at once for different groups
+    void RecordDrawGroups(VkCommandBuffer cmd, u32 groupBegin, u32 groupEnd, RenderStats& outStats);
+    VkCommandBuffer BeginSecondaryCommandBuffer(ThreadCommandPool& pool, VkFramebuffer framebuffer) const;
+    // The calling thread's ThreadCommandPool
+    u32 GetRecordingThreadSlot() const;
+    // The GPU driven path, culling has to be recorded outside the render pass and drawing inside it
+    void CullObjectsOnGPU(VkCommandBuffer cmd);
+    void DrawObjectsIndirect(VkCommandBuffer cmd);
 
     void LoadMeshes();
-    void UploadMesh(Mesh& mesh);
-
-    void Render() override;
+    // Adds the mesh right away so it can be referenced, it is drawn once it has been read, uploaded and made resident
+    Mesh* RequestMesh(const std::string& name, const std::string& cookedPath, const std::string& objPath);
+    // Runs on a job, reads the cooked mesh or falls back to the OBJ
+    void LoadMeshData(MeshLoadResult& result, const std::string& cookedPath, const std::string& objPath) const;
+    // Maps a cooked mesh and takes its draw state, false if it is missing or unusable
+    bool LoadCookedMesh(MeshLoadResult& result, const std::string& path) const;
+    // Uploads what the jobs finished and makes meshes resident whose uploads landed, cmd is the frame's
+    void UpdateMeshStreaming(VkCommandBuffer cmd);
+    // Takes the mesh's space in the geometry pool, defragmenting it into cmd when that helps
+    bool AllocateMeshGeometry(VkCommandBuffer cmd, Mesh& mesh, size_t vertexDataSize, size_t indexDataSize);
+    void DefragmentGeometry(VkCommandBuffer cmd);
+    // Uploads the CPU side streams into the mesh's geometry, returns the staging uploader serial
+    u64 UploadMesh(Mesh& mesh);
+
+    void ImmediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function);
+    bool WriteReadback(const std::string& path);
+
+    void Render(const RenderSnapshot& snapshot) override;
+    RenderStats GetRenderStats() const override;
 
 private:
     bool myIsInitialized = false;
     int myFrameNumber = 0;
+    bool myIsOffscreen = false;
+    std::string myReadbackPath{};
+    VertexFormat myVertexFormat = VertexFormat::Full;
+    bool myUseGPUDrivenRendering = false;
+    bool myUseBindless = false;
+    int mySceneObjectCount = 0;
+    uint32_t myLastImageIndex{};
+    RenderSnapshot mySnapshot{};
 
     vkb::Instance myVKBInstance{};
     VkInstance myInstance{};
@@ -125,44 +237,82 @@ private:
     VkPhysicalDeviceProperties myPhysicalDeviceProperties{};
     VkDebugUtilsMessengerEXT myDebugMessenger{};
     VkPhysicalDeviceProperties myGPUProperties{};
+    // Of the graphics queue family, 0 when it can't write timestamps
+    uint32_t myTimestampValidBits{};
 
     VkSwapchainKHR mySwapchain{};
     VkFormat mySwapchainImageFormat{};
     Vector<VkImage> mySwapchainImages{};
     Vector<VkImageView> mySwapchainImageViews{};
+    Vector<AllocatedImage> myOffscreenImages{};
 
     VkImageView myDepthImageView{};
     AllocatedImage myDepthImage{};
     VkFormat myDepthFormat{};
 
     VmaAllocator myAllocator{};
+    PipelineCache myPipelineCache{};
+    PipelineRegistry myPipelineRegistry{};
 
     VkQueue myGraphicsQueue{};
     uint32_t myGraphicsQueueFamily{};
+    // The graphics queue when the device has no separate transfer family
+    VkQueue myTransferQueue{};
+    uint32_t myTransferQueueFamily{};
 
     VkRenderPass myRenderPass{};
     Vector<VkFramebuffer> myFramebuffers{};
 
     VkDescriptorSetLayout myGlobalSetLayout{};
-    VkDescriptorPool myDescriptorPool{};
+    // Sets that live as long as the backend, handed out through the set cache
+    DescriptorAllocator myDescriptorAllocator{};
+    DescriptorLayoutCache myDescriptorLayoutCache{};
+    DescriptorSetCache myDescriptorSetCache{};
+    // Only with myUseBindless, set 1 of every material's layout
+    BindlessTable myBindlessTable{};
+    AllocatedBuffer myMaterialBuffer{};
+    GPUMaterialData* myMappedMaterials{};
+    BindlessHandle myMaterialBufferHandle = BindlessTable::INVALID_HANDLE;
 
     VkExtent2D myWindowExtent{};
 
     FrameData myFrames[FRAME_OVERLAP];
+    UploadContext myUploadContext{};
+    StagingUploader myStagingUploader{};
+    GeometryPool myGeometryPool{};
+    GPUCulling myGPUCulling{};
+    GPUProfiler myGPUProfiler{};
+    // Null without VK_KHR_draw_indirect_count
+    PFN_vkCmdDrawIndexedIndirectCountKHR myDrawIndexedIndirectCount{};
     FrameData& GetCurrentFrame();
 
     GPUSceneData mySceneParameters{};
-    AllocatedBuffer mySceneParameterBuffer{};
 
     Vector<RenderObject> myRenderables;
+    RenderQueue myRenderQueue{};
+    BoundingSphereSoA myWorldBounds{};
+    Vector<u32> myVisibleObjects{};
+    // Filled by PrepareDraws for DrawObjects
+    RenderObject* myDrawObjects{};
+    Vector<DrawGroup> myDrawGroups{};
+    uint32_t myDrawUniformOffsets[2]{};
+    TransientAllocation myDrawInstances{};
+    Vector<VkCommandBuffer> myChunkCommandBuffers{};
+    Vector<RenderStats> myChunkStats{};
+    Vector<GPUMeshData> myGPUMeshes{};
+    RenderStats myRenderStats{};
 
     // TODO move this?
     VkPipelineLayout myTrianglePipelineLayout{};
-    VkPipeline myTrianglePipeline{};
-    Mesh myMesh{};
 
 	std::unordered_map<std::string, Material> myMaterials;
     std::unordered_map<std::string, Mesh> myMeshes;
+
+    JobCounter myMeshLoadCounter{};
+    std::mutex myLoadedMeshesMutex{};
+    // Filled by the load jobs, guarded by myLoadedMeshesMutex
+    Vector<MeshLoadResult> myLoadedMeshes{};
+    Vector<StreamingMesh> myStreamingMeshes{};
 };
 
 namespace PlatformLayer
@@ -0,0 +1,226 @@
+#include "vulkan_bindless.h"
+
+#include "odyssey.h"
+
+#include "odyssey/core/assert.h"
+
+#include <algorithm>
+
+static const VkDescriptorType locDescriptorTypes[] =
+{
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_SAMPLER,
+};
+
+static const u32 locBindings[] =
+{
+    BindlessTable::STORAGE_BUFFER_BINDING,
+    BindlessTable::SAMPLED_IMAGE_BINDING,
+    BindlessTable::SAMPLER_BINDING,
+};
+
+constexpr u32 locTypeCount = static_cast<u32>(BindlessResourceType::Count);
+
+// The bindings are visible to every stage, so each one has to fit the per stage limits as well as
+// the per set ones. Storage buffers and sampled images also share the per stage resource limit.
+static void ComputeCapacities(const VkPhysicalDeviceDescriptorIndexingProperties& properties, u32* outCapacities)
+{
+    u32& storageBuffers = outCapacities[static_cast<u32>(BindlessResourceType::StorageBuffer)];
+    u32& sampledImages = outCapacities[static_cast<u32>(BindlessResourceType::SampledImage)];
+    u32& samplers = outCapacities[static_cast<u32>(BindlessResourceType::Sampler)];
+
+    storageBuffers = std::min({ BindlessTable::MAX_STORAGE_BUFFERS, properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers, properties.maxDescriptorSetUpdateAfterBindStorageBuffers });
+    sampledImages = std::min({ BindlessTable::MAX_SAMPLED_IMAGES, properties.maxPerStageDescriptorUpdateAfterBindSampledImages, properties.maxDescriptorSetUpdateAfterBindSampledImages });
+    samplers = std::min({ BindlessTable::MAX_SAMPLERS, properties.maxPerStageDescriptorUpdateAfterBindSamplers, properties.maxDescriptorSetUpdateAfterBindSamplers });
+
+    const u32 stageResources = properties.maxPerStageUpdateAfterBindResources > BindlessTable::RESERVED_STAGE_RESOURCES
+        ? properties.maxPerStageUpdateAfterBindResources - BindlessTable::RESERVED_STAGE_RESOURCES : 0;
+    const u32 poolDescriptors = properties.maxUpdateAfterBindDescriptorsInAllPools > samplers
+        ? properties.maxUpdateAfterBindDescriptorsInAllPools - samplers : 0;
+    const u32 budget = std::min(stageResources, poolDescriptors);
+    if (storageBuffers + sampledImages > budget)
+    {
+        storageBuffers = std::min(storageBuffers, budget / 2);
+        sampledImages = std::min(sampledImages, budget - storageBuffers);
+    }
+}
+
+bool BindlessTable::Initialize(VkDevice device, const VkPhysicalDeviceDescriptorIndexingProperties& properties)
+{
+    myDevice = device;
+
+    u32 capacities[locTypeCount]{};
+    ComputeCapacities(properties, capacities);
+    for (u32 i = 0; i < locTypeCount; ++i)
+    {
+        if (capacities[i] == 0)
+        {
+            Logger::LogWarn("The device has no update after bind descriptors left for bindless resource type {}", i);
+            return false;
+        }
+    }
+
+    VkDescriptorSetLayoutBinding bindings[locTypeCount]{};
+    VkDescriptorBindingFlags bindingFlags[locTypeCount]{};
+    VkDescriptorPoolSize poolSizes[locTypeCount]{};
+    for (u32 i = 0; i < locTypeCount; ++i)
+    {
+        bindings[i].binding = locBindings[i];
+        bindings[i].descriptorType = locDescriptorTypes[i];
+        bindings[i].descriptorCount = capacities[i];
+        bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+        // Unused slots hold nothing, used ones are written while the set is bound
+        bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+        poolSizes[i].type = locDescriptorTypes[i];
+        poolSizes[i].descriptorCount = capacities[i];
+
+        mySlots[i] = {};
+        mySlots[i].myCapacity = capacities[i];
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = locTypeCount;
+    bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setInfo.pNext = &bindingFlagsInfo;
+    setInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    setInfo.bindingCount = locTypeCount;
+    setInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(myDevice, &setInfo, nullptr, &mySetLayout) != VK_SUCCESS)
+        return false;
+
+    // Its own pool, update after bind sets can't come from the ordinary descriptor pools
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = locTypeCount;
+    poolInfo.pPoolSizes = poolSizes;
+    if (vkCreateDescriptorPool(myDevice, &poolInfo, nullptr, &myPool) != VK_SUCCESS)
+        return false;
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = myPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &mySetLayout;
+    return vkAllocateDescriptorSets(myDevice, &allocInfo, &mySet) == VK_SUCCESS;
+}
+
+void BindlessTable::Destroy()
+{
+    if (!myDevice)
+        return;
+
+    vkDestroyDescriptorPool(myDevice, myPool, nullptr);
+    vkDestroyDescriptorSetLayout(myDevice, mySetLayout, nullptr);
+    myPool = VK_NULL_HANDLE;
+    mySetLayout = VK_NULL_HANDLE;
+    mySet = VK_NULL_HANDLE;
+    myRetiredHandles.clear();
+    myDevice = VK_NULL_HANDLE;
+}
+
+BindlessHandle BindlessTable::RegisterStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    const BindlessHandle handle = AllocateHandle(BindlessResourceType::StorageBuffer);
+    if (handle == INVALID_HANDLE)
+        return INVALID_HANDLE;
+
+    const VkDescriptorBufferInfo bufferInfo = { buffer, offset, range };
+    WriteDescriptor(BindlessResourceType::StorageBuffer, handle, &bufferInfo, nullptr);
+    return handle;
+}
+
+BindlessHandle BindlessTable::RegisterSampledImage(VkImageView imageView, VkImageLayout layout)
+{
+    const BindlessHandle handle = AllocateHandle(BindlessResourceType::SampledImage);
+    if (handle == INVALID_HANDLE)
+        return INVALID_HANDLE;
+
+    const VkDescriptorImageInfo imageInfo = { VK_NULL_HANDLE, imageView, layout };
+    WriteDescriptor(BindlessResourceType::SampledImage, handle, nullptr, &imageInfo);
+    return handle;
+}
+
+BindlessHandle BindlessTable::RegisterSampler(VkSampler sampler)
+{
+    const BindlessHandle handle = AllocateHandle(BindlessResourceType::Sampler);
+    if (handle == INVALID_HANDLE)
+        return INVALID_HANDLE;
+
+    const VkDescriptorImageInfo imageInfo = { sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+    WriteDescriptor(BindlessResourceType::Sampler, handle, nullptr, &imageInfo);
+    return handle;
+}
+
+void BindlessTable::Release(BindlessResourceType type, BindlessHandle handle, u64 frame)
+{
+    ASSERT_MSG(handle < mySlots[static_cast<u32>(type)].myNextHandle, "Releasing a bindless handle that was never handed out");
+    myRetiredHandles.push_back({ type, handle, frame });
+}
+
+void BindlessTable::ReleaseRetiredHandles(u64 completedFrame)
+{
+    for (size_t i = 0; i < myRetiredHandles.size();)
+    {
+        const RetiredHandle& retired = myRetiredHandles[i];
+        if (retired.myFrame > completedFrame)
+        {
+            ++i;
+            continue;
+        }
+
+        Slots& slots = mySlots[static_cast<u32>(retired.myType)];
+        slots.myFreeHandles.push_back(retired.myHandle);
+        --slots.myUsedCount;
+
+        myRetiredHandles[i] = myRetiredHandles.back();
+        myRetiredHandles.pop_back();
+    }
+}
+
+BindlessHandle BindlessTable::AllocateHandle(BindlessResourceType type)
+{
+    Slots& slots = mySlots[static_cast<u32>(type)];
+
+    BindlessHandle handle = INVALID_HANDLE;
+    if (!slots.myFreeHandles.empty())
+    {
+        handle = slots.myFreeHandles.back();
+        slots.myFreeHandles.pop_back();
+    }
+    else if (slots.myNextHandle < slots.myCapacity)
+    {
+        handle = slots.myNextHandle++;
+    }
+    else
+    {
+        Logger::LogError("Bindless table is out of slots for resource type {}", static_cast<u32>(type));
+        return INVALID_HANDLE;
+    }
+
+    ++slots.myUsedCount;
+    return handle;
+}
+
+void BindlessTable::WriteDescriptor(BindlessResourceType type, BindlessHandle handle, const VkDescriptorBufferInfo* bufferInfo, const VkDescriptorImageInfo* imageInfo) const
+{
+    const u32 typeIndex = static_cast<u32>(type);
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = mySet;
+    write.dstBinding = locBindings[typeIndex];
+    write.dstArrayElement = handle;
+    write.descriptorCount = 1;
+    write.descriptorType = locDescriptorTypes[typeIndex];
+    write.pBufferInfo = bufferInfo;
+    write.pImageInfo = imageInfo;
+    vkUpdateDescriptorSets(myDevice, 1, &write, 0, nullptr);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "odyssey/types.h"
+#include "vulkan_types.h"
+
+using BindlessHandle = u32;
+
+enum class BindlessResourceType : u32
+{
+    StorageBuffer,
+    SampledImage,
+    Sampler,
+    Count
+};
+
+// Mirrors MaterialData in triangle_bindless.frag
+struct GPUMaterialData
+{
+    Vec4 myBaseColor{ 1.0f };
+};
+
+// Mirrors DrawConstants in triangle_bindless.frag, pushed per draw group instead of binding sets
+struct BindlessPushConstants
+{
+    BindlessHandle myMaterialBuffer{};
+    u32 myMaterialIndex{};
+};
+
+// One descriptor set with a large array per resource type, storage buffers at binding 0, sampled
+// images at 1 and samplers at 2. Resources are registered once and referred to by their index in
+// the array from then on, shaders get the indices through push constants or other buffers, so draws
+// with different resources need no descriptor binds in between.
+//
+// Built on descriptor indexing, the arrays are partially bound and slots are written while the set
+// is bound to command buffers still in flight. That is only allowed for slots none of them use, so
+// a released slot is kept until the frame it was released in is done, like retired geometry buffers.
+// Only used from the render thread.
+class BindlessTable
+{
+public:
+    static constexpr u32 STORAGE_BUFFER_BINDING = 0;
+    static constexpr u32 SAMPLED_IMAGE_BINDING = 1;
+    static constexpr u32 SAMPLER_BINDING = 2;
+
+    // Clamped to the device's update after bind limits, see GetCapacity
+    static constexpr u32 MAX_STORAGE_BUFFERS = 16 * 1024;
+    static constexpr u32 MAX_SAMPLED_IMAGES = 16 * 1024;
+    static constexpr u32 MAX_SAMPLERS = 64;
+    // Per stage resources left for the other sets of a pipeline layout the table is used in
+    static constexpr u32 RESERVED_STAGE_RESOURCES = 64;
+
+    static constexpr BindlessHandle INVALID_HANDLE = ~0u;
+
+    // False when the device's limits leave no room for some resource type
+    bool Initialize(VkDevice device, const VkPhysicalDeviceDescriptorIndexingProperties& properties);
+    void Destroy();
+
+    // INVALID_HANDLE when the table is full
+    BindlessHandle RegisterStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+    BindlessHandle RegisterSampledImage(VkImageView imageView, VkImageLayout layout);
+    BindlessHandle RegisterSampler(VkSampler sampler);
+    // The slot is handed out again once ReleaseRetiredHandles gets past frame
+    void Release(BindlessResourceType type, BindlessHandle handle, u64 frame);
+    void ReleaseRetiredHandles(u64 completedFrame);
+
+    VkDescriptorSetLayout GetSetLayout() const { return mySetLayout; }
+    VkDescriptorSet GetSet() const { return mySet; }
+    u32 GetUsedCount(BindlessResourceType type) const { return mySlots[static_cast<u32>(type)].myUsedCount; }
+    u32 GetCapacity(BindlessResourceType type) const { return mySlots[static_cast<u32>(type)].myCapacity; }
+
+private:
+    struct Slots
+    {
+        Vector<BindlessHandle> myFreeHandles{};
+        u32 myNextHandle{};
+        u32 myCapacity{};
+        u32 myUsedCount{};
+    };
+
+    struct RetiredHandle
+    {
+        BindlessResourceType myType{};
+        BindlessHandle myHandle{};
+        u64 myFrame{};
+    };
+
+    BindlessHandle AllocateHandle(BindlessResourceType type);
+    void WriteDescriptor(BindlessResourceType type, BindlessHandle handle, const VkDescriptorBufferInfo* bufferInfo, const VkDescriptorImageInfo* imageInfo) const;
+
+    VkDevice myDevice{};
+    VkDescriptorSetLayout mySetLayout{};
+    VkDescriptorPool myPool{};
+    VkDescriptorSet mySet{};
+
+    Slots mySlots[static_cast<u32>(BindlessResourceType::Count)]{};
+    Vector<RetiredHandle> myRetiredHandles{};
+};
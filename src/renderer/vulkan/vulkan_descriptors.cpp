@@ -0,0 +1,250 @@
+#include "vulkan_descriptors.h"
+
+#include "odyssey.h"
+
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+
+// Descriptors of each type a pool gets per set it can hold
+static const std::pair<VkDescriptorType, float> locPoolSizeRatios[] =
+{
+    { VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+    { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.0f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4.0f },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2.0f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f },
+};
+
+template <typename T>
+static void AppendKey(std::string& key, const T& value)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Only plain values can go into a descriptor key");
+    key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void DescriptorAllocator::Initialize(VkDevice device, u32 setsPerPool)
+{
+    myDevice = device;
+    myNextPoolSize = std::max(setsPerPool, 1u);
+}
+
+void DescriptorAllocator::Destroy()
+{
+    if (!myDevice)
+        return;
+
+    if (myCurrentPool)
+        myUsedPools.push_back(myCurrentPool);
+    for (const VkDescriptorPool pool : myUsedPools)
+        vkDestroyDescriptorPool(myDevice, pool, nullptr);
+    for (const VkDescriptorPool pool : myFreePools)
+        vkDestroyDescriptorPool(myDevice, pool, nullptr);
+
+    myCurrentPool = VK_NULL_HANDLE;
+    myUsedPools.clear();
+    myFreePools.clear();
+    myStats = {};
+    myDevice = VK_NULL_HANDLE;
+}
+
+bool DescriptorAllocator::Allocate(VkDescriptorSetLayout layout, VkDescriptorSet* outSet)
+{
+    if (!myCurrentPool)
+        myCurrentPool = GrabPool();
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = myCurrentPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    VkResult result = vkAllocateDescriptorSets(myDevice, &allocInfo, outSet);
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+    {
+        // Out of sets or of one descriptor type, either way the pool is done until the next reset
+        ++myStats.myPoolExhaustedCount;
+        myUsedPools.push_back(myCurrentPool);
+        myCurrentPool = GrabPool();
+
+        allocInfo.descriptorPool = myCurrentPool;
+        result = vkAllocateDescriptorSets(myDevice, &allocInfo, outSet);
+    }
+
+    if (result != VK_SUCCESS)
+    {
+        Logger::LogError("Failed to allocate a descriptor set: {}", static_cast<int>(result));
+        return false;
+    }
+
+    ++myStats.mySetCount;
+    ++myStats.myTotalSetCount;
+    return true;
+}
+
+void DescriptorAllocator::Reset()
+{
+    if (myCurrentPool)
+        myUsedPools.push_back(myCurrentPool);
+    myCurrentPool = VK_NULL_HANDLE;
+
+    for (const VkDescriptorPool pool : myUsedPools)
+    {
+        VK_CHECK(vkResetDescriptorPool(myDevice, pool, 0));
+        myFreePools.push_back(pool);
+    }
+    myUsedPools.clear();
+
+    myStats.myFreePoolCount = static_cast<u32>(myFreePools.size());
+    myStats.mySetCount = 0;
+}
+
+VkDescriptorPool DescriptorAllocator::GrabPool()
+{
+    if (!myFreePools.empty())
+    {
+        const VkDescriptorPool pool = myFreePools.back();
+        myFreePools.pop_back();
+        myStats.myFreePoolCount = static_cast<u32>(myFreePools.size());
+        return pool;
+    }
+
+    const VkDescriptorPool pool = CreatePool(myNextPoolSize);
+    myNextPoolSize = std::min(myNextPoolSize + myNextPoolSize / 2, MAX_SETS_PER_POOL);
+    ++myStats.myPoolCount;
+    return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::CreatePool(u32 setCount) const
+{
+    VkDescriptorPoolSize sizes[std::size(locPoolSizeRatios)]{};
+    for (size_t i = 0; i < std::size(locPoolSizeRatios); ++i)
+    {
+        sizes[i].type = locPoolSizeRatios[i].first;
+        sizes[i].descriptorCount = std::max(static_cast<u32>(locPoolSizeRatios[i].second * setCount), 1u);
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = 0;
+    poolInfo.maxSets = setCount;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(std::size(sizes));
+    poolInfo.pPoolSizes = sizes;
+
+    VkDescriptorPool pool{};
+    VK_CHECK(vkCreateDescriptorPool(myDevice, &poolInfo, nullptr, &pool));
+    return pool;
+}
+
+void DescriptorLayoutCache::Initialize(VkDevice device)
+{
+    myDevice = device;
+}
+
+void DescriptorLayoutCache::Destroy()
+{
+    for (const auto& [key, layout] : myLayouts)
+        vkDestroyDescriptorSetLayout(myDevice, layout, nullptr);
+    myLayouts.clear();
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::CreateLayout(const VkDescriptorSetLayoutBinding* bindings, u32 bindingCount, VkDescriptorSetLayoutCreateFlags flags)
+{
+    ++myRequestCount;
+
+    Vector<VkDescriptorSetLayoutBinding> sortedBindings(bindings, bindings + bindingCount);
+    std::sort(sortedBindings.begin(), sortedBindings.end(),
+        [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+
+    // Immutable samplers aren't used, a binding is fully described by these
+    std::string key;
+    AppendKey(key, flags);
+    for (const VkDescriptorSetLayoutBinding& binding : sortedBindings)
+    {
+        AppendKey(key, binding.binding);
+        AppendKey(key, binding.descriptorType);
+        AppendKey(key, binding.descriptorCount);
+        AppendKey(key, binding.stageFlags);
+    }
+
+    const auto existing = myLayouts.find(key);
+    if (existing != myLayouts.end())
+        return existing->second;
+
+    VkDescriptorSetLayoutCreateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setInfo.flags = flags;
+    setInfo.bindingCount = bindingCount;
+    setInfo.pBindings = sortedBindings.data();
+
+    VkDescriptorSetLayout layout{};
+    VK_CHECK(vkCreateDescriptorSetLayout(myDevice, &setInfo, nullptr, &layout));
+    myLayouts.emplace(std::move(key), layout);
+    return layout;
+}
+
+void DescriptorSetCache::Initialize(VkDevice device, DescriptorAllocator* allocator)
+{
+    myDevice = device;
+    myAllocator = allocator;
+}
+
+void DescriptorSetCache::Clear()
+{
+    mySets.clear();
+}
+
+VkDescriptorSet DescriptorSetCache::GetSet(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, u32 bindingCount)
+{
+    std::string key;
+    AppendKey(key, layout);
+    for (u32 i = 0; i < bindingCount; ++i)
+    {
+        const DescriptorBinding& binding = bindings[i];
+        AppendKey(key, binding.myBinding);
+        AppendKey(key, binding.myType);
+        AppendKey(key, binding.myBufferInfo.buffer);
+        AppendKey(key, binding.myBufferInfo.offset);
+        AppendKey(key, binding.myBufferInfo.range);
+        AppendKey(key, binding.myImageInfo.sampler);
+        AppendKey(key, binding.myImageInfo.imageView);
+        AppendKey(key, binding.myImageInfo.imageLayout);
+    }
+
+    const auto existing = mySets.find(key);
+    if (existing != mySets.end())
+    {
+        ++myHitCount;
+        return existing->second;
+    }
+
+    VkDescriptorSet set{};
+    if (!myAllocator->Allocate(layout, &set))
+        return VK_NULL_HANDLE;
+
+    Vector<VkWriteDescriptorSet> writes(bindingCount);
+    for (u32 i = 0; i < bindingCount; ++i)
+    {
+        const DescriptorBinding& binding = bindings[i];
+        VkWriteDescriptorSet& write = writes[i];
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = binding.myBinding;
+        write.descriptorCount = 1;
+        write.descriptorType = binding.myType;
+
+        const bool isImage = binding.myType == VK_DESCRIPTOR_TYPE_SAMPLER || binding.myType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+            || binding.myType == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE || binding.myType == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        if (isImage)
+            write.pImageInfo = &binding.myImageInfo;
+        else
+            write.pBufferInfo = &binding.myBufferInfo;
+    }
+    vkUpdateDescriptorSets(myDevice, bindingCount, writes.data(), 0, nullptr);
+
+    mySets.emplace(std::move(key), set);
+    return set;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include "odyssey/types.h"
+#include "vulkan_types.h"
+
+struct DescriptorAllocatorStats
+{
+    u32 myPoolCount{};
+    // Reset pools waiting to be handed out again, included in myPoolCount
+    u32 myFreePoolCount{};
+    // Sets handed out since the last reset
+    u32 mySetCount{};
+    u32 myTotalSetCount{};
+    // Times a full pool made it chain another one
+    u32 myPoolExhaustedCount{};
+};
+
+// Hands out descriptor sets from a chain of pools. When the current pool runs out another one is
+// taken, each new pool sized a bit larger than the last, so nothing has to know up front how many
+// sets or descriptors of each type it needs. Sets are never freed one by one, Reset returns every
+// pool at once, which suits per frame allocators reset when the frame's fence has signaled.
+// Only used from one thread at a time.
+class DescriptorAllocator
+{
+public:
+    static constexpr u32 MAX_SETS_PER_POOL = 4096;
+
+    void Initialize(VkDevice device, u32 setsPerPool);
+    void Destroy();
+
+    // False when even a fresh pool couldn't hold the set
+    bool Allocate(VkDescriptorSetLayout layout, VkDescriptorSet* outSet);
+    // Every set handed out so far becomes invalid
+    void Reset();
+
+    const DescriptorAllocatorStats& GetStats() const { return myStats; }
+
+private:
+    VkDescriptorPool GrabPool();
+    VkDescriptorPool CreatePool(u32 setCount) const;
+
+    VkDevice myDevice{};
+    u32 myNextPoolSize{};
+    VkDescriptorPool myCurrentPool{};
+    Vector<VkDescriptorPool> myUsedPools{};
+    Vector<VkDescriptorPool> myFreePools{};
+
+    DescriptorAllocatorStats myStats{};
+};
+
+// Creates each distinct set layout once. Bindings are compared after sorting them by binding
+// index, so the order they are listed in doesn't matter. Owns the layouts it hands out.
+class DescriptorLayoutCache
+{
+public:
+    void Initialize(VkDevice device);
+    void Destroy();
+
+    VkDescriptorSetLayout CreateLayout(const VkDescriptorSetLayoutBinding* bindings, u32 bindingCount, VkDescriptorSetLayoutCreateFlags flags = 0);
+
+    u32 GetLayoutCount() const { return static_cast<u32>(myLayouts.size()); }
+    u32 GetRequestCount() const { return myRequestCount; }
+
+private:
+    VkDevice myDevice{};
+    std::unordered_map<std::string, VkDescriptorSetLayout> myLayouts{};
+    u32 myRequestCount{};
+};
+
+// One resource written to a set, either a buffer or an image depending on myType
+struct DescriptorBinding
+{
+    u32 myBinding{};
+    VkDescriptorType myType{};
+    VkDescriptorBufferInfo myBufferInfo{};
+    VkDescriptorImageInfo myImageInfo{};
+};
+
+// Sets that never change once written, keyed on their layout and everything bound to them, so
+// materials binding the same resources share one set instead of each allocating and writing their
+// own. Sets come from a persistent allocator that is never reset.
+class DescriptorSetCache
+{
+public:
+    void Initialize(VkDevice device, DescriptorAllocator* allocator);
+    // The sets go with the allocator's pools
+    void Clear();
+
+    // Null when the allocator couldn't provide a new set
+    VkDescriptorSet GetSet(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, u32 bindingCount);
+
+    u32 GetSetCount() const { return static_cast<u32>(mySets.size()); }
+    u32 GetHitCount() const { return myHitCount; }
+
+private:
+    VkDevice myDevice{};
+    DescriptorAllocator* myAllocator{};
+    std::unordered_map<std::string, VkDescriptorSet> mySets{};
+    u32 myHitCount{};
+};
@@ -0,0 +1,185 @@
+#include "vulkan_geometry_pool.h"
+
+#include "odyssey/core/assert.h"
+
+#include <algorithm>
+
+void GeometryPool::Initialize(VmaAllocator allocator, u32 vertexStride, u32 vertexCapacity, u32 indexCapacity)
+{
+    myAllocator = allocator;
+    myVertexStride = vertexStride;
+    myVertexCapacity = vertexCapacity;
+    myIndexCapacity = indexCapacity;
+
+    myVertexRanges.Initialize(vertexCapacity);
+    myIndexRanges.Initialize(indexCapacity);
+
+    CreateBuffers();
+}
+
+void GeometryPool::Destroy()
+{
+    if (!myAllocator)
+        return;
+
+    ReleaseRetiredBuffers(~0ull);
+
+    vmaDestroyBuffer(myAllocator, myVertexBuffer.myBuffer, myVertexBuffer.myAllocation);
+    vmaDestroyBuffer(myAllocator, myIndexBuffer.myBuffer, myIndexBuffer.myAllocation);
+    myVertexBuffer = {};
+    myIndexBuffer = {};
+    myAllocator = VK_NULL_HANDLE;
+}
+
+bool GeometryPool::Allocate(u32 vertexCount, u32 indexSize, GeometryAllocation& outAllocation)
+{
+    ASSERT_MSG(!outAllocation.myIsAllocated, "Geometry allocation is already in use");
+
+    const u64 vertexOffset = myVertexRanges.Allocate(vertexCount);
+    if (vertexOffset == RangeAllocator::INVALID_OFFSET)
+        return false;
+
+    const u64 indexOffset = myIndexRanges.Allocate(indexSize, INDEX_ALIGNMENT);
+    if (indexOffset == RangeAllocator::INVALID_OFFSET)
+    {
+        myVertexRanges.Free(vertexOffset);
+        return false;
+    }
+
+    outAllocation.myVertexOffset = static_cast<u32>(vertexOffset);
+    outAllocation.myVertexCount = vertexCount;
+    outAllocation.myIndexOffset = static_cast<u32>(indexOffset);
+    outAllocation.myIndexSize = indexSize;
+    outAllocation.myIsAllocated = true;
+    return true;
+}
+
+void GeometryPool::Free(GeometryAllocation& allocation)
+{
+    if (!allocation.myIsAllocated)
+        return;
+
+    myVertexRanges.Free(allocation.myVertexOffset);
+    myIndexRanges.Free(allocation.myIndexOffset);
+    allocation = {};
+}
+
+bool GeometryPool::CanFitAfterDefragment(u32 vertexCount, u32 indexSize) const
+{
+    // Every index allocation may waste up to the alignment once it is packed
+    const u64 indexPadding = static_cast<u64>(myIndexRanges.GetStats().myAllocationCount + 1) * INDEX_ALIGNMENT;
+    return vertexCount <= myVertexRanges.GetFreeSize() && indexSize + indexPadding <= myIndexRanges.GetFreeSize();
+}
+
+void GeometryPool::Defragment(VkCommandBuffer cmd, const Vector<GeometryAllocation*>& allocations, u64 frame)
+{
+    ASSERT_MSG(allocations.size() == myVertexRanges.GetStats().myAllocationCount, "Defragmenting needs every live allocation");
+
+    const AllocatedBuffer oldVertexBuffer = myVertexBuffer;
+    const AllocatedBuffer oldIndexBuffer = myIndexBuffer;
+    CreateBuffers();
+    myRetiredBuffers.push_back({ oldVertexBuffer, frame });
+    myRetiredBuffers.push_back({ oldIndexBuffer, frame });
+
+    // In the order they already are in memory so that neighbouring meshes stay neighbours
+    Vector<GeometryAllocation*> sorted = allocations;
+    std::sort(sorted.begin(), sorted.end(), [](const GeometryAllocation* lhs, const GeometryAllocation* rhs) { return lhs->myVertexOffset < rhs->myVertexOffset; });
+
+    myVertexRanges.Reset();
+    myIndexRanges.Reset();
+
+    Vector<VkBufferCopy> vertexCopies;
+    Vector<VkBufferCopy> indexCopies;
+    vertexCopies.reserve(sorted.size());
+    indexCopies.reserve(sorted.size());
+
+    for (GeometryAllocation* allocation : sorted)
+    {
+        const u64 vertexOffset = myVertexRanges.Allocate(allocation->myVertexCount);
+        const u64 indexOffset = myIndexRanges.Allocate(allocation->myIndexSize, INDEX_ALIGNMENT);
+        ASSERT_MSG(vertexOffset != RangeAllocator::INVALID_OFFSET && indexOffset != RangeAllocator::INVALID_OFFSET, "Defragmented geometry doesn't fit");
+
+        VkBufferCopy vertexCopy{};
+        vertexCopy.srcOffset = static_cast<VkDeviceSize>(allocation->myVertexOffset) * myVertexStride;
+        vertexCopy.dstOffset = vertexOffset * myVertexStride;
+        vertexCopy.size = static_cast<VkDeviceSize>(allocation->myVertexCount) * myVertexStride;
+        vertexCopies.push_back(vertexCopy);
+
+        VkBufferCopy indexCopy{};
+        indexCopy.srcOffset = allocation->myIndexOffset;
+        indexCopy.dstOffset = indexOffset;
+        indexCopy.size = allocation->myIndexSize;
+        indexCopies.push_back(indexCopy);
+
+        myDefragmentedBytes += vertexCopy.size + indexCopy.size;
+
+        allocation->myVertexOffset = static_cast<u32>(vertexOffset);
+        allocation->myIndexOffset = static_cast<u32>(indexOffset);
+    }
+
+    if (!vertexCopies.empty())
+    {
+        vkCmdCopyBuffer(cmd, oldVertexBuffer.myBuffer, myVertexBuffer.myBuffer, static_cast<uint32_t>(vertexCopies.size()), vertexCopies.data());
+        vkCmdCopyBuffer(cmd, oldIndexBuffer.myBuffer, myIndexBuffer.myBuffer, static_cast<uint32_t>(indexCopies.size()), indexCopies.data());
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    ++myDefragmentCount;
+}
+
+void GeometryPool::ReleaseRetiredBuffers(u64 completedFrame)
+{
+    for (size_t i = 0; i < myRetiredBuffers.size();)
+    {
+        RetiredBuffer& retired = myRetiredBuffers[i];
+        if (retired.myFrame > completedFrame)
+        {
+            ++i;
+            continue;
+        }
+
+        vmaDestroyBuffer(myAllocator, retired.myBuffer.myBuffer, retired.myBuffer.myAllocation);
+        retired = myRetiredBuffers.back();
+        myRetiredBuffers.pop_back();
+    }
+}
+
+GeometryPoolStats GeometryPool::GetStats() const
+{
+    GeometryPoolStats stats{};
+    stats.myVertexStats = myVertexRanges.GetStats();
+    stats.myIndexStats = myIndexRanges.GetStats();
+    stats.myVertexStride = myVertexStride;
+    stats.myDefragmentCount = myDefragmentCount;
+    stats.myDefragmentedBytes = myDefragmentedBytes;
+    return stats;
+}
+
+void GeometryPool::CreateBuffers()
+{
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = static_cast<VkDeviceSize>(myVertexCapacity) * myVertexStride;
+    // Transfer source for defragmenting
+    bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    // Filled through the staging uploader, the GPU reads them every frame so they belong in VRAM
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    VmaAllocationInfo allocationInfo{};
+    VK_CHECK(vmaCreateBuffer(myAllocator, &bufferInfo, &allocInfo, &myVertexBuffer.myBuffer, &myVertexBuffer.myAllocation, &allocationInfo));
+
+    VkMemoryPropertyFlags memoryFlags{};
+    vmaGetMemoryTypeProperties(myAllocator, allocationInfo.memoryType, &memoryFlags);
+    myIsDeviceLocal = (memoryFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0;
+
+    bufferInfo.size = myIndexCapacity;
+    bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    VK_CHECK(vmaCreateBuffer(myAllocator, &bufferInfo, &allocInfo, &myIndexBuffer.myBuffer, &myIndexBuffer.myAllocation, nullptr));
+}
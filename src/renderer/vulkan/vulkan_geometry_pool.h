@@ -0,0 +1,86 @@
+#pragma once
+
+#include "odyssey/types.h"
+#include "renderer/range_allocator.h"
+#include "vulkan_types.h"
+
+// Where a mesh lives inside the geometry pool
+struct GeometryAllocation
+{
+    // In vertices, the vertexOffset of its draws
+    u32 myVertexOffset{};
+    u32 myVertexCount{};
+    // In bytes, always a multiple of the index size so that firstIndex is myIndexOffset / index size
+    u32 myIndexOffset{};
+    u32 myIndexSize{};
+    bool myIsAllocated = false;
+};
+
+struct GeometryPoolStats
+{
+    // In vertices
+    RangeAllocatorStats myVertexStats{};
+    // In bytes
+    RangeAllocatorStats myIndexStats{};
+    u32 myVertexStride{};
+    u32 myDefragmentCount{};
+    u64 myDefragmentedBytes{};
+};
+
+// One device local vertex buffer and one index buffer that every mesh is suballocated from, so
+// drawing needs a single vertex buffer bind and meshes differ only in their draw offsets. All
+// vertices share one stride, indices can be 16 or 32 bit per mesh.
+class GeometryPool
+{
+public:
+    // Indices are aligned to this, which covers both index types
+    static constexpr u32 INDEX_ALIGNMENT = 4;
+
+    void Initialize(VmaAllocator allocator, u32 vertexStride, u32 vertexCapacity, u32 indexCapacity);
+    void Destroy();
+
+    // False when there is no free range large enough, which defragmenting may fix
+    bool Allocate(u32 vertexCount, u32 indexSize, GeometryAllocation& outAllocation);
+    void Free(GeometryAllocation& allocation);
+    // Enough space in total, just not in one piece
+    bool CanFitAfterDefragment(u32 vertexCount, u32 indexSize) const;
+
+    // Moves all allocations to the front of new buffers with copies recorded into cmd, which has to
+    // run on the queue owning the pool after every upload into it. allocations must be every live
+    // allocation and is updated in place. The old buffers stay alive until ReleaseRetiredBuffers
+    // is called with a frame at or after the given one.
+    void Defragment(VkCommandBuffer cmd, const Vector<GeometryAllocation*>& allocations, u64 frame);
+    // Destroys buffers replaced by Defragment that no frame up to completedFrame can still read
+    void ReleaseRetiredBuffers(u64 completedFrame);
+
+    VkBuffer GetVertexBuffer() const { return myVertexBuffer.myBuffer; }
+    VkBuffer GetIndexBuffer() const { return myIndexBuffer.myBuffer; }
+    u32 GetVertexStride() const { return myVertexStride; }
+    bool IsDeviceLocal() const { return myIsDeviceLocal; }
+
+    GeometryPoolStats GetStats() const;
+
+private:
+    struct RetiredBuffer
+    {
+        AllocatedBuffer myBuffer{};
+        u64 myFrame{};
+    };
+
+    void CreateBuffers();
+
+    VmaAllocator myAllocator{};
+    AllocatedBuffer myVertexBuffer{};
+    AllocatedBuffer myIndexBuffer{};
+    u32 myVertexStride{};
+    u32 myVertexCapacity{};
+    u32 myIndexCapacity{};
+    bool myIsDeviceLocal = false;
+
+    RangeAllocator myVertexRanges{};
+    RangeAllocator myIndexRanges{};
+
+    Vector<RetiredBuffer> myRetiredBuffers{};
+    u32 myDefragmentCount{};
+    u64 myDefragmentedBytes{};
+};
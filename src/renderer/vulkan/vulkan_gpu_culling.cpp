@@ -0,0 +1,275 @@
+#include "vulkan_gpu_culling.h"
+
+#include "odyssey/core/assert.h"
+#include "vulkan_descriptors.h"
+#include "vulkan_initializers.h"
+#include "vulkan_staging_uploader.h"
+#include "vulkan_transient_allocator.h"
+
+#include <algorithm>
+#include <cstring>
+
+bool GPUCulling::Initialize(VkDevice device, VmaAllocator allocator, VkPipelineCache pipelineCache, DescriptorLayoutCache& layoutCache, VkShaderModule cullShader, u32 frameCount,
+    PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount, u32 maxDrawIndirectCount)
+{
+    myDevice = device;
+    myAllocator = allocator;
+    myDrawIndexedIndirectCount = drawIndexedIndirectCount;
+    myMaxDrawIndirectCount = std::max(maxDrawIndirectCount, 1u);
+
+    // Objects, meshes, draws, draw counts and instances, the mesh table lives in the frame's transient buffer
+    VkDescriptorSetLayoutBinding bindings[5]{};
+    for (uint32_t i = 0; i < 5; ++i)
+        bindings[i] = VulkanInit::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, i);
+    mySetLayout = layoutCache.CreateLayout(bindings, 5);
+
+    VkPushConstantRange pushConstants{};
+    pushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstants.offset = 0;
+    pushConstants.size = sizeof(CullConstants);
+
+    VkPipelineLayoutCreateInfo layoutInfo = VulkanInit::PipelineLayoutCreateInfo();
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &mySetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstants;
+    VK_CHECK(vkCreatePipelineLayout(myDevice, &layoutInfo, nullptr, &myPipelineLayout));
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = VulkanInit::PipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, cullShader);
+    pipelineInfo.layout = myPipelineLayout;
+    if (vkCreateComputePipelines(myDevice, pipelineCache, 1, &pipelineInfo, nullptr, &myPipeline) != VK_SUCCESS)
+        return false;
+
+    myFrames.resize(frameCount);
+    return true;
+}
+
+void GPUCulling::Destroy()
+{
+    if (!myDevice)
+        return;
+
+    ReleaseRetiredBuffers(~0ull);
+    for (FrameResources& frame : myFrames)
+        DestroyFrameResources(frame);
+    myFrames.clear();
+
+    if (myObjectBuffer.myBuffer)
+        vmaDestroyBuffer(myAllocator, myObjectBuffer.myBuffer, myObjectBuffer.myAllocation);
+    myObjectBuffer = {};
+
+    vkDestroyPipeline(myDevice, myPipeline, nullptr);
+    vkDestroyPipelineLayout(myDevice, myPipelineLayout, nullptr);
+    myDevice = VK_NULL_HANDLE;
+}
+
+void GPUCulling::SetObjects(StagingUploader& uploader, const Vector<GPUObjectData>& objects, u64 frame)
+{
+    if (myObjectBuffer.myBuffer)
+        myRetiredBuffers.push_back({ myObjectBuffer, frame });
+    myObjectBuffer = {};
+    myObjectCount = static_cast<u32>(objects.size());
+
+    if (objects.empty())
+        return;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = objects.size() * sizeof(GPUObjectData);
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    // Only changes with the scene, the culling pass reads all of it every frame
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    VK_CHECK(vmaCreateBuffer(myAllocator, &bufferInfo, &allocInfo, &myObjectBuffer.myBuffer, &myObjectBuffer.myAllocation, nullptr));
+
+    myObjectSerial = uploader.Upload(myObjectBuffer.myBuffer, 0, objects.data(), objects.size() * sizeof(GPUObjectData));
+}
+
+void GPUCulling::ReleaseRetiredBuffers(u64 completedFrame)
+{
+    for (size_t i = 0; i < myRetiredBuffers.size();)
+    {
+        RetiredBuffer& retired = myRetiredBuffers[i];
+        if (retired.myFrame > completedFrame)
+        {
+            ++i;
+            continue;
+        }
+
+        vmaDestroyBuffer(myAllocator, retired.myBuffer.myBuffer, retired.myBuffer.myAllocation);
+        retired = myRetiredBuffers.back();
+        myRetiredBuffers.pop_back();
+    }
+}
+
+void GPUCulling::Cull(VkCommandBuffer cmd, u32 frameIndex, const Frustum& frustum, TransientAllocator& transientAllocator, DescriptorAllocator& descriptorAllocator, const Vector<GPUMeshData>& meshes)
+{
+    FrameResources& frame = myFrames[frameIndex];
+    frame.myHasCulled = false;
+    if (myObjectCount == 0 || meshes.empty())
+        return;
+
+    const TransientAllocation meshAllocation = transientAllocator.Allocate(meshes.size() * sizeof(GPUMeshData));
+    if (!meshAllocation.myData)
+        return;
+    memcpy(meshAllocation.myData, meshes.data(), meshes.size() * sizeof(GPUMeshData));
+
+    // A new set every frame, the mesh table moves around the transient buffer and the frame's
+    // descriptor allocator is reset as a whole once the frame is done
+    VkDescriptorSet descriptorSet{};
+    if (!descriptorAllocator.Allocate(mySetLayout, &descriptorSet))
+        return;
+
+    if (frame.myCapacity != myObjectCount)
+        ResizeFrameResources(frame, myObjectCount);
+
+    VkDescriptorBufferInfo bufferInfos[5]{};
+    bufferInfos[0] = { myObjectBuffer.myBuffer, 0, VK_WHOLE_SIZE };
+    bufferInfos[1] = { meshAllocation.myBuffer, meshAllocation.myOffset, meshes.size() * sizeof(GPUMeshData) };
+    bufferInfos[2] = { frame.myDrawBuffer.myBuffer, 0, VK_WHOLE_SIZE };
+    bufferInfos[3] = { frame.myDrawCountBuffer.myBuffer, 0, VK_WHOLE_SIZE };
+    bufferInfos[4] = { frame.myInstanceBuffer.myBuffer, 0, VK_WHOLE_SIZE };
+
+    VkWriteDescriptorSet writes[5]{};
+    for (uint32_t i = 0; i < 5; ++i)
+        writes[i] = VulkanInit::WriteDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, descriptorSet, &bufferInfos[i], i);
+    vkUpdateDescriptorSets(myDevice, 5, writes, 0, nullptr);
+
+    vkCmdFillBuffer(cmd, frame.myDrawCountBuffer.myBuffer, 0, VK_WHOLE_SIZE, 0);
+    // Drawn at full length without a count, every command the shader doesn't write has to draw nothing
+    if (!UsesDrawCount(frame))
+        vkCmdFillBuffer(cmd, frame.myDrawBuffer.myBuffer, 0, VK_WHOLE_SIZE, 0);
+
+    VkMemoryBarrier clearBarrier{};
+    clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    CullConstants constants{};
+    for (int i = 0; i < 6; ++i)
+        constants.myFrustumPlanes[i] = frustum.myPlanes[i];
+    constants.myObjectCount = myObjectCount;
+    constants.myDrawCapacity = frame.myCapacity;
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, myPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, myPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(cmd, myPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+    vkCmdDispatch(cmd, (myObjectCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+    // Draws read the commands and transforms, the host reads the counts once the frame's fence signals
+    VkMemoryBarrier cullBarrier{};
+    cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+    frame.myHasCulled = true;
+}
+
+u32 GPUCulling::Draw(VkCommandBuffer cmd, u32 frameIndex, VkBuffer indexBuffer) const
+{
+    const FrameResources& frame = myFrames[frameIndex];
+    if (!frame.myHasCulled)
+        return 0;
+
+    const VkDeviceSize instanceOffset = 0;
+    vkCmdBindVertexBuffers(cmd, 1, 1, &frame.myInstanceBuffer.myBuffer, &instanceOffset);
+
+    const VkIndexType indexTypes[DRAW_LIST_COUNT] = { VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32 };
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+    u32 drawCalls = 0;
+    for (u32 list = 0; list < DRAW_LIST_COUNT; ++list)
+    {
+        vkCmdBindIndexBuffer(cmd, indexBuffer, 0, indexTypes[list]);
+
+        const VkDeviceSize drawOffset = static_cast<VkDeviceSize>(list) * frame.myCapacity * stride;
+        if (UsesDrawCount(frame))
+        {
+            myDrawIndexedIndirectCount(cmd, frame.myDrawBuffer.myBuffer, drawOffset, frame.myDrawCountBuffer.myBuffer, list * sizeof(u32), frame.myCapacity, stride);
+            ++drawCalls;
+            continue;
+        }
+
+        for (u32 first = 0; first < frame.myCapacity; first += myMaxDrawIndirectCount)
+        {
+            const u32 count = std::min(frame.myCapacity - first, myMaxDrawIndirectCount);
+            vkCmdDrawIndexedIndirect(cmd, frame.myDrawBuffer.myBuffer, drawOffset + static_cast<VkDeviceSize>(first) * stride, count, stride);
+            ++drawCalls;
+        }
+    }
+
+    return drawCalls;
+}
+
+bool GPUCulling::ReadVisibleCount(u32 frameIndex, u32& outVisibleCount) const
+{
+    const FrameResources& frame = myFrames[frameIndex];
+    if (!frame.myHasCulled)
+        return false;
+
+    vmaInvalidateAllocation(myAllocator, frame.myDrawCountBuffer.myAllocation, 0, VK_WHOLE_SIZE);
+
+    outVisibleCount = 0;
+    for (u32 list = 0; list < DRAW_LIST_COUNT; ++list)
+        outVisibleCount += frame.myMappedDrawCounts[list];
+    return true;
+}
+
+void GPUCulling::ResizeFrameResources(FrameResources& frame, u32 capacity)
+{
+    DestroyFrameResources(frame);
+    frame.myCapacity = capacity;
+
+    if (capacity > myMaxDrawIndirectCount)
+    {
+        Logger::LogWarn("{} objects are more than the {} draws an indirect call can take, drawing each list in {} calls",
+            capacity, myMaxDrawIndirectCount, (capacity + myMaxDrawIndirectCount - 1) / myMaxDrawIndirectCount);
+    }
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    // Every object can end up in either list
+    bufferInfo.size = static_cast<VkDeviceSize>(DRAW_LIST_COUNT) * capacity * sizeof(VkDrawIndexedIndirectCommand);
+    bufferInfo.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    VK_CHECK(vmaCreateBuffer(myAllocator, &bufferInfo, &allocInfo, &frame.myDrawBuffer.myBuffer, &frame.myDrawBuffer.myAllocation, nullptr));
+
+    // The lists share it, one from each end
+    bufferInfo.size = static_cast<VkDeviceSize>(capacity) * sizeof(Mat4);
+    bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    VK_CHECK(vmaCreateBuffer(myAllocator, &bufferInfo, &allocInfo, &frame.myInstanceBuffer.myBuffer, &frame.myInstanceBuffer.myAllocation, nullptr));
+
+    bufferInfo.size = DRAW_LIST_COUNT * sizeof(u32);
+    bufferInfo.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo allocationInfo{};
+    VK_CHECK(vmaCreateBuffer(myAllocator, &bufferInfo, &allocInfo, &frame.myDrawCountBuffer.myBuffer, &frame.myDrawCountBuffer.myAllocation, &allocationInfo));
+    frame.myMappedDrawCounts = static_cast<u32*>(allocationInfo.pMappedData);
+    ASSERT_MSG(frame.myMappedDrawCounts, "Draw count buffer must be mapped");
+}
+
+void GPUCulling::DestroyFrameResources(FrameResources& frame)
+{
+    if (frame.myDrawBuffer.myBuffer)
+        vmaDestroyBuffer(myAllocator, frame.myDrawBuffer.myBuffer, frame.myDrawBuffer.myAllocation);
+    if (frame.myDrawCountBuffer.myBuffer)
+        vmaDestroyBuffer(myAllocator, frame.myDrawCountBuffer.myBuffer, frame.myDrawCountBuffer.myAllocation);
+    if (frame.myInstanceBuffer.myBuffer)
+        vmaDestroyBuffer(myAllocator, frame.myInstanceBuffer.myBuffer, frame.myInstanceBuffer.myAllocation);
+
+    frame.myDrawBuffer = {};
+    frame.myDrawCountBuffer = {};
+    frame.myMappedDrawCounts = nullptr;
+    frame.myInstanceBuffer = {};
+    frame.myCapacity = 0;
+}
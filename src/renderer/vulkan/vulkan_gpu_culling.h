@@ -0,0 +1,132 @@
+#pragma once
+
+#include "odyssey/types.h"
+#include "renderer/frustum_culling.h"
+#include "vulkan_types.h"
+
+class StagingUploader;
+class TransientAllocator;
+class DescriptorAllocator;
+class DescriptorLayoutCache;
+
+// Mirrors ObjectData in cull.comp
+struct GPUObjectData
+{
+    Mat4 myTransform{ 1.0f };
+    u32 myMeshIndex{};
+    u32 myPadding[3]{};
+};
+
+// Mirrors MeshData in cull.comp
+struct GPUMeshData
+{
+    Mat4 myDequantizeTransform{ 1.0f };
+    // Object space center and radius
+    Vec4 myBoundingSphere{};
+    // 0 keeps every object using the mesh from being drawn
+    u32 myIndexCount{};
+    u32 myFirstIndex{};
+    i32 myVertexOffset{};
+    // GPUCulling::DrawList
+    u32 myDrawList{};
+};
+
+static_assert(sizeof(GPUObjectData) == 80, "GPUObjectData must match the std430 layout in cull.comp");
+static_assert(sizeof(GPUMeshData) == 96, "GPUMeshData must match the std430 layout in cull.comp");
+
+// GPU driven culling and drawing. Every object lives in one storage buffer, a compute pass frustum
+// culls them all and appends the visible ones as indexed indirect draws, and two indirect calls draw
+// them, so the CPU cost of a frame doesn't depend on the object count. Draws are split into one list
+// per index type since a list is drawn with a single index buffer binding.
+//
+// Uses vkCmdDrawIndexedIndirectCount when the device has VK_KHR_draw_indirect_count. Without it the
+// lists are cleared every frame and drawn at full length, the unused commands draw zero instances.
+// Lists longer than the device's maxDrawIndirectCount are drawn that way too, split over several
+// calls, as a single count can't be split between them.
+class GPUCulling
+{
+public:
+    static constexpr u32 GROUP_SIZE = 64;
+
+    enum DrawList : u32
+    {
+        DRAW_LIST_UINT16,
+        DRAW_LIST_UINT32,
+        DRAW_LIST_COUNT
+    };
+
+    bool Initialize(VkDevice device, VmaAllocator allocator, VkPipelineCache pipelineCache, DescriptorLayoutCache& layoutCache, VkShaderModule cullShader, u32 frameCount,
+        PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount, u32 maxDrawIndirectCount);
+    void Destroy();
+
+    // Uploads the objects into a new buffer, usable once the uploader acquired GetObjectSerial. The
+    // old buffer is released like the geometry pool's, see GeometryPool::ReleaseRetiredBuffers.
+    void SetObjects(StagingUploader& uploader, const Vector<GPUObjectData>& objects, u64 frame);
+    void ReleaseRetiredBuffers(u64 completedFrame);
+
+    // Records the culling pass, outside a render pass. meshes is indexed by GPUObjectData::myMeshIndex
+    // and goes into the frame's transient buffer, the descriptor set comes from the frame's descriptor
+    // allocator. The frame's last use must be done on the GPU.
+    void Cull(VkCommandBuffer cmd, u32 frameIndex, const Frustum& frustum, TransientAllocator& transientAllocator, DescriptorAllocator& descriptorAllocator, const Vector<GPUMeshData>& meshes);
+    // Records the indirect draws inside the render pass. Expects the pipeline, its descriptors and the
+    // geometry pool's vertex buffer bound, binds the instance transforms and the index buffer itself.
+    // Returns the number of draw calls.
+    u32 Draw(VkCommandBuffer cmd, u32 frameIndex, VkBuffer indexBuffer) const;
+
+    // Objects the GPU found visible the last time the frame was culled, once its fence has been
+    // waited on. False when that frame didn't cull.
+    bool ReadVisibleCount(u32 frameIndex, u32& outVisibleCount) const;
+
+    u64 GetObjectSerial() const { return myObjectSerial; }
+    u32 GetObjectCount() const { return myObjectCount; }
+    bool HasDrawIndirectCount() const { return myDrawIndexedIndirectCount != nullptr; }
+
+private:
+    struct CullConstants
+    {
+        Vec4 myFrustumPlanes[6];
+        u32 myObjectCount;
+        u32 myDrawCapacity;
+    };
+
+    struct FrameResources
+    {
+        // DRAW_LIST_COUNT lists of myCapacity commands each
+        AllocatedBuffer myDrawBuffer{};
+        // Host visible so the visible count can be read without a copy
+        AllocatedBuffer myDrawCountBuffer{};
+        u32* myMappedDrawCounts{};
+        AllocatedBuffer myInstanceBuffer{};
+        u32 myCapacity{};
+        bool myHasCulled = false;
+    };
+
+    struct RetiredBuffer
+    {
+        AllocatedBuffer myBuffer{};
+        u64 myFrame{};
+    };
+
+    // Only called once the frame's last use is done, so its buffers can be replaced right away
+    void ResizeFrameResources(FrameResources& frame, u32 capacity);
+    bool UsesDrawCount(const FrameResources& frame) const { return myDrawIndexedIndirectCount && frame.myCapacity <= myMaxDrawIndirectCount; }
+    void DestroyFrameResources(FrameResources& frame);
+
+    VkDevice myDevice{};
+    VmaAllocator myAllocator{};
+    PFN_vkCmdDrawIndexedIndirectCountKHR myDrawIndexedIndirectCount{};
+    // Only 65535 is guaranteed
+    u32 myMaxDrawIndirectCount{};
+
+    // Owned by the layout cache
+    VkDescriptorSetLayout mySetLayout{};
+    VkPipelineLayout myPipelineLayout{};
+    VkPipeline myPipeline{};
+
+    AllocatedBuffer myObjectBuffer{};
+    u32 myObjectCount{};
+    u64 myObjectSerial{};
+
+    Vector<FrameResources> myFrames{};
+    Vector<RetiredBuffer> myRetiredBuffers{};
+};
@@ -0,0 +1,147 @@
+#include "vulkan_gpu_profiler.h"
+
+#include "odyssey.h"
+
+#include <algorithm>
+
+void GPUProfiler::Initialize(VkDevice device, const VkPhysicalDeviceProperties& properties, u32 timestampValidBits, u32 frameCount)
+{
+    myDevice = device;
+
+    if (timestampValidBits == 0 || properties.limits.timestampPeriod <= 0.0f)
+    {
+        Logger::LogWarn("The graphics queue can't write timestamps, GPU profiling is off");
+        return;
+    }
+
+    myTimestampPeriod = properties.limits.timestampPeriod;
+    myTimestampMask = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = MAX_SCOPES_PER_FRAME * 2;
+
+    myFrames.resize(frameCount);
+    for (FrameQueries& frame : myFrames)
+    {
+        VK_CHECK(vkCreateQueryPool(myDevice, &poolInfo, nullptr, &frame.myQueryPool));
+        frame.myHistoryIndices.reserve(MAX_SCOPES_PER_FRAME);
+    }
+    myResults.resize(MAX_SCOPES_PER_FRAME * 4);
+}
+
+void GPUProfiler::Destroy()
+{
+    for (const FrameQueries& frame : myFrames)
+        vkDestroyQueryPool(myDevice, frame.myQueryPool, nullptr);
+
+    myFrames.clear();
+    myCurrentFrame = nullptr;
+    myDevice = VK_NULL_HANDLE;
+}
+
+void GPUProfiler::BeginFrame(VkCommandBuffer cmd, u32 frameIndex)
+{
+    if (!IsEnabled())
+        return;
+
+    FrameQueries& frame = myFrames[frameIndex];
+    ReadResults(frame);
+
+    frame.myHistoryIndices.clear();
+    vkCmdResetQueryPool(cmd, frame.myQueryPool, 0, MAX_SCOPES_PER_FRAME * 2);
+    myCurrentFrame = &frame;
+}
+
+u32 GPUProfiler::BeginScope(VkCommandBuffer cmd, const char* name)
+{
+    if (!myCurrentFrame || myCurrentFrame->myHistoryIndices.size() >= MAX_SCOPES_PER_FRAME)
+        return INVALID_SCOPE;
+
+    const u32 scope = static_cast<u32>(myCurrentFrame->myHistoryIndices.size());
+    myCurrentFrame->myHistoryIndices.push_back(FindHistory(name));
+
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, myCurrentFrame->myQueryPool, scope * 2);
+    return scope;
+}
+
+void GPUProfiler::EndScope(VkCommandBuffer cmd, u32 scope)
+{
+    if (!myCurrentFrame || scope == INVALID_SCOPE)
+        return;
+
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, myCurrentFrame->myQueryPool, scope * 2 + 1);
+}
+
+void GPUProfiler::GetTimings(Vector<GPUScopeTiming>& outTimings) const
+{
+    outTimings.clear();
+    for (const ScopeHistory& history : myHistories)
+    {
+        if (history.myCount == 0)
+            continue;
+
+        const u32 oldest = (history.myHead + HISTORY_SIZE - history.myCount) % HISTORY_SIZE;
+
+        GPUScopeTiming timing{};
+        timing.myName = history.myName;
+        timing.myLastTime = history.myTimes[(history.myHead + HISTORY_SIZE - 1) % HISTORY_SIZE];
+        timing.myMinTime = timing.myLastTime;
+        timing.myMaxTime = timing.myLastTime;
+        timing.mySampleCount = history.myCount;
+
+        double sum = 0.0;
+        for (u32 i = 0; i < history.myCount; ++i)
+        {
+            const float time = history.myTimes[(oldest + i) % HISTORY_SIZE];
+            timing.myMinTime = std::min(timing.myMinTime, time);
+            timing.myMaxTime = std::max(timing.myMaxTime, time);
+            sum += time;
+        }
+        timing.myAverageTime = static_cast<float>(sum / history.myCount);
+
+        outTimings.push_back(std::move(timing));
+    }
+}
+
+void GPUProfiler::ReadResults(FrameQueries& frame)
+{
+    const u32 scopeCount = static_cast<u32>(frame.myHistoryIndices.size());
+    if (scopeCount == 0)
+        return;
+
+    // The frame's fence has been waited on, so this doesn't wait. With availability a scope that
+    // was begun but never ended just reads as unavailable instead of failing the whole read.
+    const VkResult result = vkGetQueryPoolResults(myDevice, frame.myQueryPool, 0, scopeCount * 2, scopeCount * 4 * sizeof(u64), myResults.data(),
+        2 * sizeof(u64), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY)
+        return;
+
+    for (u32 scope = 0; scope < scopeCount; ++scope)
+    {
+        const u64* begin = &myResults[scope * 4];
+        const u64* end = begin + 2;
+        if (!begin[1] || !end[1])
+            continue;
+
+        const u64 ticks = (end[0] - begin[0]) & myTimestampMask;
+        ScopeHistory& history = myHistories[frame.myHistoryIndices[scope]];
+        history.myTimes[history.myHead] = static_cast<float>(ticks * myTimestampPeriod / 1000000.0);
+        history.myHead = (history.myHead + 1) % HISTORY_SIZE;
+        history.myCount = std::min(history.myCount + 1, HISTORY_SIZE);
+    }
+}
+
+u32 GPUProfiler::FindHistory(const char* name)
+{
+    for (u32 i = 0; i < myHistories.size(); ++i)
+    {
+        if (myHistories[i].myName == name)
+            return i;
+    }
+
+    myHistories.emplace_back();
+    myHistories.back().myName = name;
+    return static_cast<u32>(myHistories.size() - 1);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+
+#include "odyssey/types.h"
+#include "renderer/renderer_backend.h"
+#include "vulkan_types.h"
+
+// Times named scopes of a frame's command buffer with timestamp queries. Every frame in flight has
+// its own query pool, which is read back at the start of that frame's next use, after its fence has
+// been waited on, so reading never stalls and the timings lag the CPU by the number of frames in
+// flight. Scopes are matched by name across frames and keep the last HISTORY_SIZE samples.
+//
+// Only the primary command buffer can be timed, and not inside a render pass that is recorded into
+// secondary command buffers. Does nothing when the queue has no timestamp support.
+class GPUProfiler
+{
+public:
+    static constexpr u32 HISTORY_SIZE = 240;
+    static constexpr u32 MAX_SCOPES_PER_FRAME = 32;
+    static constexpr u32 INVALID_SCOPE = ~0u;
+
+    // timestampValidBits of the queue family the command buffers are submitted to
+    void Initialize(VkDevice device, const VkPhysicalDeviceProperties& properties, u32 timestampValidBits, u32 frameCount);
+    void Destroy();
+
+    // Reads what the frame slot measured last time and resets its queries, has to be recorded
+    // first in the command buffer, outside any render pass
+    void BeginFrame(VkCommandBuffer cmd, u32 frameIndex);
+
+    // INVALID_SCOPE once the frame is out of queries, which EndScope ignores
+    u32 BeginScope(VkCommandBuffer cmd, const char* name);
+    void EndScope(VkCommandBuffer cmd, u32 scope);
+
+    bool IsEnabled() const { return !myFrames.empty(); }
+    void GetTimings(Vector<GPUScopeTiming>& outTimings) const;
+
+private:
+    struct FrameQueries
+    {
+        VkQueryPool myQueryPool{};
+        // Per scope recorded into the pool, in query order, where its times go
+        Vector<u32> myHistoryIndices{};
+    };
+
+    struct ScopeHistory
+    {
+        std::string myName{};
+        float myTimes[HISTORY_SIZE]{};
+        u32 myHead{};
+        u32 myCount{};
+    };
+
+    void ReadResults(FrameQueries& frame);
+    u32 FindHistory(const char* name);
+
+    VkDevice myDevice{};
+    // Nanoseconds per timestamp tick
+    double myTimestampPeriod{};
+    u64 myTimestampMask{};
+
+    Vector<FrameQueries> myFrames{};
+    FrameQueries* myCurrentFrame{};
+    Vector<ScopeHistory> myHistories{};
+    Vector<u64> myResults{};
+};
+
+// Times everything recorded into cmd until the end of the enclosing block
+class GPUProfileScope
+{
+public:
+    GPUProfileScope(GPUProfiler& profiler, VkCommandBuffer cmd, const char* name)
+        : myProfiler(profiler), myCommandBuffer(cmd), myScope(profiler.BeginScope(cmd, name))
+    {
+    }
+
+    ~GPUProfileScope()
+    {
+        myProfiler.EndScope(myCommandBuffer, myScope);
+    }
+
+    GPUProfileScope(const GPUProfileScope&) = delete;
+    GPUProfileScope& operator=(const GPUProfileScope&) = delete;
+
+private:
+    GPUProfiler& myProfiler;
+    VkCommandBuffer myCommandBuffer{};
+    u32 myScope{};
+};
@@ -3,15 +3,27 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
+#include "odyssey/core/job_system.h"
 #include "odyssey/core/logger.h"
+#include "renderer/cooked_mesh.h"
+#include "renderer/mesh_optimizer.h"
+#include "renderer/obj_parser.h"
+#include "renderer/vertex_packing.h"
 
-VertexInputDescription Vertex::GetVertexInputDescription()
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+VertexInputDescription Vertex::GetVertexInputDescription(VertexFormat format)
 {
 	VertexInputDescription description;
 
+	const bool isPacked = format == VertexFormat::Packed;
+
 	VkVertexInputBindingDescription mainBinding{};
 	mainBinding.binding = 0;
-	mainBinding.stride = sizeof(Vertex);
+	mainBinding.stride = GetVertexStride(format);
 	mainBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
 	description.myBindings.push_back(mainBinding);
@@ -19,29 +31,71 @@ VertexInputDescription Vertex::GetVertexInputDescription()
 	VkVertexInputAttributeDescription positionAttribute{};
 	positionAttribute.binding = 0;
 	positionAttribute.location = 0;
-	positionAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
-	positionAttribute.offset = offsetof(Vertex, myPosition);
+	positionAttribute.format = isPacked ? VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R32G32B32_SFLOAT;
+	positionAttribute.offset = isPacked ? offsetof(PackedVertex, myPosition) : offsetof(Vertex, myPosition);
 
 	VkVertexInputAttributeDescription normalAttribute{};
 	normalAttribute.binding = 0;
 	normalAttribute.location = 1;
-	normalAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
-	normalAttribute.offset = offsetof(Vertex, myNormal);
+	normalAttribute.format = isPacked ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+	normalAttribute.offset = isPacked ? offsetof(PackedVertex, myNormal) : offsetof(Vertex, myNormal);
 
 	VkVertexInputAttributeDescription colorAttribute{};
 	colorAttribute.binding = 0;
 	colorAttribute.location = 2;
-	colorAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
-	colorAttribute.offset = offsetof(Vertex, myColor);
+	colorAttribute.format = isPacked ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R32G32B32_SFLOAT;
+	colorAttribute.offset = isPacked ? offsetof(PackedVertex, myColor) : offsetof(Vertex, myColor);
 
 	description.myAttributes.push_back(positionAttribute);
 	description.myAttributes.push_back(normalAttribute);
 	description.myAttributes.push_back(colorAttribute);
 
+	VkVertexInputBindingDescription instanceBinding{};
+	instanceBinding.binding = 1;
+	instanceBinding.stride = sizeof(InstanceData);
+	instanceBinding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	description.myBindings.push_back(instanceBinding);
+
+	// A mat4 attribute takes up one location per column
+	for (uint32_t column = 0; column < 4; ++column)
+	{
+		VkVertexInputAttributeDescription transformAttribute{};
+		transformAttribute.binding = 1;
+		transformAttribute.location = 3 + column;
+		transformAttribute.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		transformAttribute.offset = static_cast<uint32_t>(offsetof(InstanceData, myTransform) + column * sizeof(Vec4));
+
+		description.myAttributes.push_back(transformAttribute);
+	}
+
 	return description;
 }
 
-bool Mesh::LoadFromObj(const String& filename)
+bool Vertex::operator==(const Vertex& other) const
+{
+	// Bitwise so that it agrees with the hash below
+	return std::memcmp(this, &other, sizeof(Vertex)) == 0;
+}
+
+struct VertexHash
+{
+	size_t operator()(const Vertex& vertex) const
+	{
+		static_assert(sizeof(Vertex) % sizeof(u32) == 0, "Vertex is hashed as 32 bit words");
+
+		u32 words[sizeof(Vertex) / sizeof(u32)];
+		std::memcpy(words, &vertex, sizeof(Vertex));
+
+		u64 hash = 14695981039346656037ull;
+		for (u32 word : words)
+			hash = (hash ^ word) * 1099511628211ull;
+		return static_cast<size_t>(hash ^ (hash >> 32));
+	}
+};
+
+// Polygons, broken files and anything else ObjParser doesn't read exactly like tinyobjloader end up here
+static bool LoadTrianglesWithTinyObj(const String& filename, Vector<Vertex>& triangleVertices)
 {
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
@@ -59,6 +113,11 @@ bool Mesh::LoadFromObj(const String& filename)
 		return false;
 	}
 
+	size_t indexCount = 0;
+	for (const auto& shape : shapes)
+		indexCount += shape.mesh.indices.size();
+	triangleVertices.reserve(indexCount);
+
 	for (const auto& shape : shapes) {
 		size_t index_offset = 0;
 		for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++) {
@@ -86,7 +145,7 @@ bool Mesh::LoadFromObj(const String& filename)
 				//we are setting the vertex color as the vertex normal. This is just for display purposes
 				vertex.myColor = vertex.myNormal;
 
-				myVertices.push_back(vertex);
+				triangleVertices.push_back(vertex);
 			}
 			index_offset += fv;
 		}
@@ -94,3 +153,271 @@ bool Mesh::LoadFromObj(const String& filename)
 
 	return true;
 }
+
+static void BuildTriangleVertices(const ObjData& data, Vector<Vertex>& triangleVertices)
+{
+	triangleVertices.resize(data.myTriangleIndices.size());
+
+	JobSystem::ParallelFor(static_cast<u32>(triangleVertices.size()), 64 * 1024, [&data, &triangleVertices](u32 begin, u32 end)
+	{
+		for (u32 i = begin; i < end; ++i)
+		{
+			const ObjIndex& index = data.myTriangleIndices[i];
+
+			Vertex& vertex = triangleVertices[i];
+			vertex.myPosition = data.myPositions[index.myPosition];
+			vertex.myNormal = index.myNormal >= 0 ? data.myNormals[index.myNormal] : Vec3(0.0f);
+			//we are setting the vertex color as the vertex normal. This is just for display purposes
+			vertex.myColor = vertex.myNormal;
+		}
+	});
+}
+
+bool Mesh::LoadFromObj(const String& filename)
+{
+	Vector<Vertex> triangleVertices;
+
+	ObjData data;
+	if (ObjParser::ParseFile(filename, data))
+		BuildTriangleVertices(data, triangleVertices);
+	else if (!LoadTrianglesWithTinyObj(filename, triangleVertices))
+		return false;
+
+	BuildIndexed(triangleVertices);
+	Optimize();
+	ComputeBounds();
+
+	Logger::Log("Loaded {}: {} triangles, {} unique vertices", filename, myIndices.size() / 3, myVertices.size());
+
+	return true;
+}
+
+void Mesh::BuildIndexed(const Vector<Vertex>& triangleVertices)
+{
+	myVertices.clear();
+	myIndices.clear();
+	myIndices.reserve(triangleVertices.size());
+
+	std::unordered_map<Vertex, u32, VertexHash> uniqueVertices;
+	uniqueVertices.reserve(triangleVertices.size());
+
+	for (const Vertex& vertex : triangleVertices)
+	{
+		const auto result = uniqueVertices.emplace(vertex, static_cast<u32>(myVertices.size()));
+		if (result.second)
+			myVertices.push_back(vertex);
+
+		myIndices.push_back(result.first->second);
+	}
+
+	myIndexCount = static_cast<u32>(myIndices.size());
+	myIndexType = myVertices.size() <= 0xFFFF ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+void Mesh::Optimize()
+{
+	if (myIndices.empty())
+		return;
+
+	const u32 vertexCount = static_cast<u32>(myVertices.size());
+	const VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(myIndices.data(), myIndices.size(), vertexCount);
+
+	Vector<u32> clusters;
+	MeshOptimizer::OptimizeVertexCache(myIndices.data(), myIndices.data(), myIndices.size(), vertexCount, MeshOptimizer::DEFAULT_CACHE_SIZE, &clusters);
+	MeshOptimizer::OptimizeOverdraw(myIndices.data(), myIndices.size(), clusters, &myVertices[0].myPosition.x, sizeof(Vertex));
+
+	Vector<u32> remap(vertexCount);
+	const u32 usedVertexCount = MeshOptimizer::BuildVertexFetchRemap(remap.data(), myIndices.data(), myIndices.size(), vertexCount);
+	MeshOptimizer::RemapVertices(myVertices, myIndices, remap, usedVertexCount);
+
+	const VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(myIndices.data(), myIndices.size(), usedVertexCount);
+	Logger::Log("Optimized mesh: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}, {} clusters",
+		before.myACMR, after.myACMR, before.myATVR, after.myATVR, clusters.size());
+}
+
+bool Mesh::SaveCooked(const String& filename) const
+{
+	CookedMeshHeader header{};
+	header.myMagic = CookedMesh::MAGIC;
+	header.myVersion = CookedMesh::VERSION;
+	header.myVertexFormat = static_cast<u32>(myVertexFormat);
+	header.myVertexStride = GetVertexStride(myVertexFormat);
+	header.myVertexCount = static_cast<u32>(GetVertexDataSize() / header.myVertexStride);
+	header.myIndexCount = myIndexCount;
+	header.myIndexStride = myIndexType == VK_INDEX_TYPE_UINT16 ? sizeof(u16) : sizeof(u32);
+
+	header.myVertexOffset = CookedMesh::AlignStream(sizeof(CookedMeshHeader));
+	header.myVertexSize = GetVertexDataSize();
+	header.myIndexOffset = CookedMesh::AlignStream(header.myVertexOffset + header.myVertexSize);
+	header.myIndexSize = GetIndexDataSize();
+
+	header.myBoundsMin = myBounds.myMin;
+	header.myBoundsMax = myBounds.myMax;
+	header.myBoundsCenter = myBounds.myCenter;
+	header.myBoundsRadius = myBounds.myRadius;
+	header.myDequantizeTransform = myDequantizeTransform;
+
+	Vector<u8> indexData(header.myIndexSize);
+	CopyIndexData(indexData.data());
+
+	return CookedMesh::Write(filename, header, GetVertexData(), indexData.data());
+}
+
+void Mesh::SetFromCooked(const CookedMeshHeader& header)
+{
+	myVertices.clear();
+	myPackedVertices.clear();
+	myIndices.clear();
+
+	myVertexFormat = static_cast<VertexFormat>(header.myVertexFormat);
+	myIndexCount = header.myIndexCount;
+	myIndexType = header.myIndexStride == sizeof(u16) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+	myBounds.myMin = header.myBoundsMin;
+	myBounds.myMax = header.myBoundsMax;
+	myBounds.myCenter = header.myBoundsCenter;
+	myBounds.myRadius = header.myBoundsRadius;
+	myDequantizeTransform = header.myDequantizeTransform;
+}
+
+void Mesh::ComputeBounds()
+{
+	if (myVertices.empty())
+	{
+		myBounds = {};
+		return;
+	}
+
+	Vec3 min = myVertices[0].myPosition;
+	Vec3 max = min;
+	for (const Vertex& vertex : myVertices)
+	{
+		min = glm::min(min, vertex.myPosition);
+		max = glm::max(max, vertex.myPosition);
+	}
+
+	const Vec3 center = (min + max) * 0.5f;
+	float radiusSquared = 0.0f;
+	for (const Vertex& vertex : myVertices)
+	{
+		const Vec3 offset = vertex.myPosition - center;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+
+	myBounds.myMin = min;
+	myBounds.myMax = max;
+	myBounds.myCenter = center;
+	myBounds.myRadius = std::sqrt(radiusSquared);
+}
+
+void Mesh::Pack()
+{
+	// Flat axes would divide by zero, any scale works for them
+	const Vec3 extent = glm::max(myBounds.myMax - myBounds.myMin, Vec3(1e-6f));
+	const Vec3 inverseExtent = 1.0f / extent;
+
+	myPackedVertices.resize(myVertices.size());
+	for (size_t i = 0; i < myVertices.size(); ++i)
+	{
+		const Vertex& vertex = myVertices[i];
+		PackedVertex& packed = myPackedVertices[i];
+
+		const Vec3 position = (vertex.myPosition - myBounds.myMin) * inverseExtent;
+		packed.myPosition[0] = VertexPacking::QuantizeUnorm16(position.x);
+		packed.myPosition[1] = VertexPacking::QuantizeUnorm16(position.y);
+		packed.myPosition[2] = VertexPacking::QuantizeUnorm16(position.z);
+		packed.myPosition[3] = 0;
+
+		const Vec2 normal = VertexPacking::OctahedralEncode(vertex.myNormal);
+		packed.myNormal[0] = VertexPacking::QuantizeSnorm16(normal.x);
+		packed.myNormal[1] = VertexPacking::QuantizeSnorm16(normal.y);
+
+		packed.myColor[0] = VertexPacking::QuantizeUnorm8(vertex.myColor.r);
+		packed.myColor[1] = VertexPacking::QuantizeUnorm8(vertex.myColor.g);
+		packed.myColor[2] = VertexPacking::QuantizeUnorm8(vertex.myColor.b);
+		packed.myColor[3] = 255;
+	}
+
+	myDequantizeTransform = glm::translate(Mat4(1.0f), myBounds.myMin) * glm::scale(Mat4(1.0f), extent);
+	myVertexFormat = VertexFormat::Packed;
+}
+
+VertexPackingError Mesh::MeasurePackingError() const
+{
+	VertexPackingError error{};
+	if (myPackedVertices.size() != myVertices.size() || myVertices.empty())
+		return error;
+
+	double positionErrorSum = 0.0;
+	double normalErrorSum = 0.0;
+
+	for (size_t i = 0; i < myVertices.size(); ++i)
+	{
+		const Vertex& vertex = myVertices[i];
+		const PackedVertex& packed = myPackedVertices[i];
+
+		// Decode the way the GPU does it
+		const Vec4 quantizedPosition(
+			VertexPacking::DequantizeUnorm16(packed.myPosition[0]),
+			VertexPacking::DequantizeUnorm16(packed.myPosition[1]),
+			VertexPacking::DequantizeUnorm16(packed.myPosition[2]),
+			1.0f);
+		const Vec3 position = Vec3(myDequantizeTransform * quantizedPosition);
+		const float positionError = glm::length(position - vertex.myPosition);
+
+		const Vec3 normal = VertexPacking::OctahedralDecode(Vec2(
+			VertexPacking::DequantizeSnorm16(packed.myNormal[0]),
+			VertexPacking::DequantizeSnorm16(packed.myNormal[1])));
+		const float cosine = glm::clamp(glm::dot(normal, glm::normalize(vertex.myNormal)), -1.0f, 1.0f);
+		const float normalError = glm::degrees(std::acos(cosine));
+
+		for (int c = 0; c < 3; ++c)
+		{
+			const float color = glm::clamp(vertex.myColor[c], 0.0f, 1.0f);
+			error.myMaxColorError = std::max(error.myMaxColorError, std::abs(VertexPacking::DequantizeUnorm8(packed.myColor[c]) - color));
+		}
+
+		error.myMaxPositionError = std::max(error.myMaxPositionError, positionError);
+		error.myMaxNormalError = std::max(error.myMaxNormalError, normalError);
+		positionErrorSum += positionError;
+		normalErrorSum += normalError;
+	}
+
+	error.myAveragePositionError = static_cast<float>(positionErrorSum / myVertices.size());
+	error.myAverageNormalError = static_cast<float>(normalErrorSum / myVertices.size());
+	return error;
+}
+
+const void* Mesh::GetVertexData() const
+{
+	if (myVertexFormat == VertexFormat::Packed)
+		return myPackedVertices.data();
+	return myVertices.data();
+}
+
+size_t Mesh::GetVertexDataSize() const
+{
+	if (myVertexFormat == VertexFormat::Packed)
+		return myPackedVertices.size() * sizeof(PackedVertex);
+	return myVertices.size() * sizeof(Vertex);
+}
+
+size_t Mesh::GetIndexDataSize() const
+{
+	const size_t indexSize = myIndexType == VK_INDEX_TYPE_UINT16 ? sizeof(u16) : sizeof(u32);
+	return myIndices.size() * indexSize;
+}
+
+void Mesh::CopyIndexData(void* destination) const
+{
+	if (myIndexType == VK_INDEX_TYPE_UINT16)
+	{
+		u16* indices = static_cast<u16*>(destination);
+		for (size_t i = 0; i < myIndices.size(); ++i)
+			indices[i] = static_cast<u16>(myIndices[i]);
+	}
+	else
+	{
+		std::memcpy(destination, myIndices.data(), myIndices.size() * sizeof(u32));
+	}
+}
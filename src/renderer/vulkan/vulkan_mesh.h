@@ -4,6 +4,9 @@
 
 #include "odyssey/types.h"
 #include "vulkan_types.h"
+#include "vulkan_geometry_pool.h"
+
+struct CookedMeshHeader;
 
 struct VertexInputDescription
 {
@@ -12,19 +15,116 @@ struct VertexInputDescription
 	VkPipelineVertexInputStateCreateFlags myFlags{};
 };
 
+enum class VertexFormat
+{
+	// Vertex, three full precision Vec3s
+	Full,
+	// PackedVertex, quantized against the mesh bounds
+	Packed
+};
+
 struct Vertex
 {
 	Vec3 myPosition;
 	Vec3 myNormal;
 	Vec3 myColor;
 
-	static VertexInputDescription GetVertexInputDescription();
+	static VertexInputDescription GetVertexInputDescription(VertexFormat format = VertexFormat::Full);
+
+	bool operator==(const Vertex& other) const;
+};
+
+struct PackedVertex
+{
+	// UNORM16 inside the mesh bounds, w is padding
+	u16 myPosition[4];
+	// Octahedral SNORM16
+	i16 myNormal[2];
+	// RGBA8 UNORM
+	u8 myColor[4];
+};
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must stay 16 bytes");
+
+// Bytes per vertex of the main vertex stream
+constexpr u32 GetVertexStride(VertexFormat format)
+{
+	return format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+// Differences between the full precision vertices and their packed versions
+struct VertexPackingError
+{
+	// In object space units
+	float myMaxPositionError{};
+	float myAveragePositionError{};
+	// In degrees
+	float myMaxNormalError{};
+	float myAverageNormalError{};
+	// In [0, 1] color units
+	float myMaxColorError{};
+};
+
+// Per instance vertex data at binding 1, streamed from the frame's transient buffer
+struct InstanceData
+{
+	Mat4 myTransform;
+};
+
+struct MeshBounds
+{
+	Vec3 myMin{};
+	Vec3 myMax{};
+	// Sphere around the box center, looser than a minimal sphere but cheap to build
+	Vec3 myCenter{};
+	float myRadius{};
 };
 
 struct Mesh
 {
 	Vector<Vertex> myVertices;
-	AllocatedBuffer myVertexBuffer;
+	Vector<u32> myIndices;
+	// Its part of the backend's geometry pool
+	GeometryAllocation myGeometry{};
+	// Same as myIndices.size(), except for cooked meshes which keep no CPU copies of their streams
+	u32 myIndexCount{};
+	// 16 bit on the GPU whenever every vertex can be addressed with it
+	VkIndexType myIndexType = VK_INDEX_TYPE_UINT32;
+	// Small id for render sort keys
+	u32 myId{};
+	// What was uploaded to the GPU, the CPU side streams may be gone
+	size_t myVertexBufferSize{};
+	size_t myIndexBufferSize{};
+	bool myIsDeviceLocal = false;
+	// Streamed in, only drawn once its buffers are filled and owned by the graphics queue
+	bool myIsResident = false;
+
+	MeshBounds myBounds{};
+
+	VertexFormat myVertexFormat = VertexFormat::Full;
+	Vector<PackedVertex> myPackedVertices;
+	// Maps packed [0, 1] positions back into object space, applied on top of the instance transform
+	Mat4 myDequantizeTransform{ 1.0f };
 
 	bool LoadFromObj(const String& filename);
+	// Writes the GPU ready streams and everything needed to draw them, see cooked_mesh.h
+	bool SaveCooked(const String& filename) const;
+	// Takes the draw state from a cooked mesh, the streams themselves are uploaded straight from the blob
+	void SetFromCooked(const CookedMeshHeader& header);
+	// Merges identical vertices of a triangle list into myVertices and myIndices
+	void BuildIndexed(const Vector<Vertex>& triangleVertices);
+	// Reorders triangles for the post transform cache and overdraw, then vertices for fetch locality
+	void Optimize();
+	void ComputeBounds();
+
+	// Builds myPackedVertices from myVertices and switches to the packed format. Needs the bounds.
+	void Pack();
+	VertexPackingError MeasurePackingError() const;
+
+	// The vertices in the format that goes to the GPU
+	const void* GetVertexData() const;
+	size_t GetVertexDataSize() const;
+	// The indices converted to myIndexType
+	size_t GetIndexDataSize() const;
+	void CopyIndexData(void* destination) const;
 };
\ No newline at end of file
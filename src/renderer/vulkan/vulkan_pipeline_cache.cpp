@@ -0,0 +1,173 @@
+#include "vulkan_pipeline_cache.h"
+
+#include "odyssey.h"
+
+#include "odyssey/platform/platform_layer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+// What every pipeline cache blob starts with, see VkPipelineCacheHeaderVersionOne
+struct PipelineCacheBlobHeader
+{
+    uint32_t myHeaderSize;
+    uint32_t myHeaderVersion;
+    uint32_t myVendorID;
+    uint32_t myDeviceID;
+    uint8_t myPipelineCacheUUID[VK_UUID_SIZE];
+};
+
+void PipelineCache::Initialize(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& path)
+{
+    myDevice = device;
+    myProperties = properties;
+    myPath = path;
+
+    const u64 start = PlatformLayer::GetTimeNanoseconds();
+    const Vector<u8> blob = LoadBlob();
+
+    VkPipelineCacheCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = blob.size();
+    createInfo.pInitialData = blob.empty() ? nullptr : blob.data();
+
+    if (vkCreatePipelineCache(myDevice, &createInfo, nullptr, &myCache) != VK_SUCCESS)
+    {
+        // The driver still rejected it, start over rather than go without a cache
+        Logger::LogWarn("Driver rejected the pipeline cache {}, starting with an empty one", myPath);
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        VK_CHECK(vkCreatePipelineCache(myDevice, &createInfo, nullptr, &myCache));
+        return;
+    }
+
+    myLoadedSize = blob.size();
+    if (IsWarm())
+        Logger::Log("Loaded {:.1f} KB pipeline cache from {} in {:.3f} ms", myLoadedSize / 1024.0, myPath, (PlatformLayer::GetTimeNanoseconds() - start) / 1000000.0);
+}
+
+void PipelineCache::Destroy()
+{
+    if (!myCache)
+        return;
+
+    Save();
+    vkDestroyPipelineCache(myDevice, myCache, nullptr);
+    myCache = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::Save() const
+{
+    if (!myCache || myPath.empty())
+        return false;
+
+    const u64 start = PlatformLayer::GetTimeNanoseconds();
+
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(myDevice, myCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+        return false;
+
+    Vector<u8> data(dataSize);
+    if (vkGetPipelineCacheData(myDevice, myCache, &dataSize, data.data()) != VK_SUCCESS)
+        return false;
+
+    FileHeader header{};
+    header.myMagic = MAGIC;
+    header.myVersion = VERSION;
+    header.myDriverVersion = myProperties.driverVersion;
+    header.myDataSize = dataSize;
+
+    const std::string tempPath = myPath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            Logger::LogWarn("Failed to write pipeline cache {}", tempPath);
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(data.data()), dataSize);
+        if (!file.good())
+        {
+            Logger::LogWarn("Failed to write pipeline cache {}", tempPath);
+            return false;
+        }
+    }
+
+    // Replaces the old cache atomically on POSIX. Windows refuses to rename onto an existing file, there
+    // the old one has to go first and a crash in between only costs the cache.
+    int renameResult = std::rename(tempPath.c_str(), myPath.c_str());
+#if IS_WINDOWS_PLATFORM
+    if (renameResult != 0)
+    {
+        std::remove(myPath.c_str());
+        renameResult = std::rename(tempPath.c_str(), myPath.c_str());
+    }
+#endif
+    if (renameResult != 0)
+    {
+        Logger::LogWarn("Failed to move pipeline cache into place at {}", myPath);
+        return false;
+    }
+
+    Logger::Log("Saved {:.1f} KB pipeline cache to {} in {:.3f} ms", dataSize / 1024.0, myPath, (PlatformLayer::GetTimeNanoseconds() - start) / 1000000.0);
+    return true;
+}
+
+Vector<u8> PipelineCache::LoadBlob() const
+{
+    std::ifstream file(myPath, std::ios::ate | std::ios::binary);
+    if (!file.is_open())
+    {
+        Logger::Log("No pipeline cache at {}, starting cold", myPath);
+        return {};
+    }
+
+    const size_t fileSize = static_cast<size_t>(file.tellg());
+    file.seekg(0);
+
+    FileHeader header{};
+    if (fileSize < sizeof(FileHeader) + sizeof(PipelineCacheBlobHeader) || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    {
+        Logger::LogWarn("Pipeline cache {} is too small, ignoring it", myPath);
+        return {};
+    }
+
+    if (header.myMagic != MAGIC || header.myVersion != VERSION || header.myDataSize != fileSize - sizeof(FileHeader))
+    {
+        Logger::LogWarn("Pipeline cache {} is not a valid cache file, ignoring it", myPath);
+        return {};
+    }
+
+    if (header.myDriverVersion != myProperties.driverVersion)
+    {
+        Logger::Log("Pipeline cache {} is from another driver version, starting cold", myPath);
+        return {};
+    }
+
+    Vector<u8> blob(static_cast<size_t>(header.myDataSize));
+    if (!file.read(reinterpret_cast<char*>(blob.data()), blob.size()))
+    {
+        Logger::LogWarn("Failed to read pipeline cache {}", myPath);
+        return {};
+    }
+
+    PipelineCacheBlobHeader blobHeader{};
+    memcpy(&blobHeader, blob.data(), sizeof(blobHeader));
+    if (blobHeader.myHeaderSize < sizeof(PipelineCacheBlobHeader) || blobHeader.myHeaderVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+    {
+        Logger::LogWarn("Pipeline cache {} has an unknown blob header, ignoring it", myPath);
+        return {};
+    }
+
+    if (blobHeader.myVendorID != myProperties.vendorID || blobHeader.myDeviceID != myProperties.deviceID
+        || memcmp(blobHeader.myPipelineCacheUUID, myProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+        Logger::Log("Pipeline cache {} is from another device or driver, starting cold", myPath);
+        return {};
+    }
+
+    return blob;
+}
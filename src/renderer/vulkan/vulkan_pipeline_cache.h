@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+
+#include "odyssey/types.h"
+#include "vulkan_types.h"
+
+// The VkPipelineCache every pipeline is created with, kept on disk between runs so that a warm
+// start skips most of the shader compilation. The file is our own small header followed by the
+// driver's blob. A blob from another vendor, device or driver is thrown away instead of handed to
+// the driver, since it couldn't be used anyway and not every driver checks it carefully.
+class PipelineCache
+{
+public:
+    // "ODYP" read as a little endian u32
+    static constexpr u32 MAGIC = 0x5059444F;
+    static constexpr u32 VERSION = 1;
+
+    // Starts from the blob at path when it was written for this device and driver, empty otherwise
+    void Initialize(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& path);
+    // Saves the cache and destroys it
+    void Destroy();
+
+    // Writes to a temporary file first so that a crash mid write never leaves a broken cache behind
+    bool Save() const;
+
+    VkPipelineCache GetCache() const { return myCache; }
+    // Whether the cache started from a valid blob on disk
+    bool IsWarm() const { return myLoadedSize > 0; }
+    size_t GetLoadedSize() const { return myLoadedSize; }
+
+private:
+    struct FileHeader
+    {
+        u32 myMagic{};
+        u32 myVersion{};
+        // The Vulkan blob header has no driver version, the UUID usually but not always changes with it
+        u32 myDriverVersion{};
+        u32 myPadding{};
+        u64 myDataSize{};
+    };
+
+    // Reads the blob at myPath and checks it against the device, empty when it can't be used
+    Vector<u8> LoadBlob() const;
+
+    VkDevice myDevice{};
+    VkPipelineCache myCache{};
+    VkPhysicalDeviceProperties myProperties{};
+    std::string myPath{};
+    size_t myLoadedSize{};
+};
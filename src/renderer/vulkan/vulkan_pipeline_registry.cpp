@@ -0,0 +1,298 @@
+#include "vulkan_pipeline_registry.h"
+
+#include "odyssey.h"
+
+#include "odyssey/platform/platform_layer.h"
+#include "vulkan_initializers.h"
+
+#include <type_traits>
+
+template <typename T>
+static void AppendKey(std::string& key, const T& value)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Only plain values can go into a pipeline key");
+    key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void AppendKey(std::string& key, const VkStencilOpState& state)
+{
+    AppendKey(key, state.failOp);
+    AppendKey(key, state.passOp);
+    AppendKey(key, state.depthFailOp);
+    AppendKey(key, state.compareOp);
+    AppendKey(key, state.compareMask);
+    AppendKey(key, state.writeMask);
+    AppendKey(key, state.reference);
+}
+
+VkPipeline PipelineBuilder::BuildPipeline(VkDevice device, VkRenderPass pass, VkPipelineCache cache) const
+{
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = VulkanInit::VertexInputStateCreateInfo();
+    vertexInputInfo.flags = myVertexInput.myFlags;
+    vertexInputInfo.pVertexBindingDescriptions = myVertexInput.myBindings.data();
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(myVertexInput.myBindings.size());
+    vertexInputInfo.pVertexAttributeDescriptions = myVertexInput.myAttributes.data();
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(myVertexInput.myAttributes.size());
+
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = &myViewport;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = &myScissor;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = {};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &myColorBlendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = nullptr;
+
+    pipelineInfo.stageCount = static_cast<uint32_t>(myShaderStages.size());
+    pipelineInfo.pStages = myShaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &myInputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &myRasterizer;
+    pipelineInfo.pMultisampleState = &myMultisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.layout = myPipelineLayout;
+    pipelineInfo.renderPass = pass;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.pDepthStencilState = &myDepthStencil;
+
+    VkPipeline newPipeline{};
+    if (vkCreateGraphicsPipelines(
+        device, cache, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS)
+    {
+        Logger::LogError("Failed to create pipeline");
+        return VK_NULL_HANDLE;
+    }
+
+    return newPipeline;
+}
+
+std::string PipelineBuilder::ComputeStateKey(VkRenderPass pass) const
+{
+    // Field by field, the create infos carry pointers and padding that say nothing about the state
+    std::string key;
+    key.reserve(512);
+
+    AppendKey(key, pass);
+    AppendKey(key, myPipelineLayout);
+
+    AppendKey(key, static_cast<u32>(myShaderStages.size()));
+    for (const VkPipelineShaderStageCreateInfo& stage : myShaderStages)
+    {
+        AppendKey(key, stage.flags);
+        AppendKey(key, stage.stage);
+        AppendKey(key, stage.module);
+        key.append(stage.pName ? stage.pName : "");
+        key.push_back('\0');
+    }
+
+    AppendKey(key, myVertexInput.myFlags);
+    AppendKey(key, static_cast<u32>(myVertexInput.myBindings.size()));
+    for (const VkVertexInputBindingDescription& binding : myVertexInput.myBindings)
+    {
+        AppendKey(key, binding.binding);
+        AppendKey(key, binding.stride);
+        AppendKey(key, binding.inputRate);
+    }
+    AppendKey(key, static_cast<u32>(myVertexInput.myAttributes.size()));
+    for (const VkVertexInputAttributeDescription& attribute : myVertexInput.myAttributes)
+    {
+        AppendKey(key, attribute.location);
+        AppendKey(key, attribute.binding);
+        AppendKey(key, attribute.format);
+        AppendKey(key, attribute.offset);
+    }
+
+    AppendKey(key, myInputAssembly.topology);
+    AppendKey(key, myInputAssembly.primitiveRestartEnable);
+
+    AppendKey(key, myViewport);
+    AppendKey(key, myScissor);
+
+    AppendKey(key, myRasterizer.depthClampEnable);
+    AppendKey(key, myRasterizer.rasterizerDiscardEnable);
+    AppendKey(key, myRasterizer.polygonMode);
+    AppendKey(key, myRasterizer.cullMode);
+    AppendKey(key, myRasterizer.frontFace);
+    AppendKey(key, myRasterizer.depthBiasEnable);
+    AppendKey(key, myRasterizer.depthBiasConstantFactor);
+    AppendKey(key, myRasterizer.depthBiasClamp);
+    AppendKey(key, myRasterizer.depthBiasSlopeFactor);
+    AppendKey(key, myRasterizer.lineWidth);
+
+    AppendKey(key, myColorBlendAttachment);
+
+    AppendKey(key, myMultisampling.rasterizationSamples);
+    AppendKey(key, myMultisampling.sampleShadingEnable);
+    AppendKey(key, myMultisampling.minSampleShading);
+    AppendKey(key, myMultisampling.alphaToCoverageEnable);
+    AppendKey(key, myMultisampling.alphaToOneEnable);
+
+    AppendKey(key, myDepthStencil.depthTestEnable);
+    AppendKey(key, myDepthStencil.depthWriteEnable);
+    AppendKey(key, myDepthStencil.depthCompareOp);
+    AppendKey(key, myDepthStencil.depthBoundsTestEnable);
+    AppendKey(key, myDepthStencil.stencilTestEnable);
+    AppendKey(key, myDepthStencil.front);
+    AppendKey(key, myDepthStencil.back);
+    AppendKey(key, myDepthStencil.minDepthBounds);
+    AppendKey(key, myDepthStencil.maxDepthBounds);
+
+    return key;
+}
+
+void PipelineRegistry::Initialize(VkDevice device, VkPipelineCache cache)
+{
+    myDevice = device;
+    myCache = cache;
+}
+
+void PipelineRegistry::Destroy()
+{
+    if (!myDevice)
+        return;
+
+    for (const PipelineHandle handle : myPendingHandles)
+        JobSystem::Wait(myEntries[handle].myPending->myCounter);
+    while (!myPendingHandles.empty())
+        Update();
+
+    Logger::Log("Pipeline registry: {} requests for {} pipelines, {} compiled in the background, {} failed, {:.3f} ms compiling",
+        myStats.myRequestCount, myStats.myPipelineCount, myStats.myBackgroundCompileCount, myStats.myFailedCount, myStats.myCompileTime / 1000000.0);
+
+    for (const Entry& entry : myEntries)
+        vkDestroyPipeline(myDevice, entry.myPipeline, nullptr);
+    for (const VkShaderModule module : myShaderModules)
+        vkDestroyShaderModule(myDevice, module, nullptr);
+
+    myEntries.clear();
+    myHandles.clear();
+    myShaderModules.clear();
+    myFallback = INVALID_HANDLE;
+    myDevice = VK_NULL_HANDLE;
+}
+
+void PipelineRegistry::AdoptShaderModule(VkShaderModule module)
+{
+    myShaderModules.push_back(module);
+}
+
+PipelineHandle PipelineRegistry::Request(const PipelineBuilder& builder, VkRenderPass pass, bool blocking)
+{
+    ++myStats.myRequestCount;
+
+    std::string key = builder.ComputeStateKey(pass);
+    const auto existing = myHandles.find(key);
+    if (existing != myHandles.end())
+    {
+        // Asked for before without blocking, the caller needs it now so finish the compile first
+        const PipelineHandle handle = existing->second;
+        const Entry& entry = myEntries[handle];
+        if (blocking && entry.myPending)
+        {
+            JobSystem::Wait(entry.myPending->myCounter);
+            Update();
+        }
+        return handle;
+    }
+
+    const PipelineHandle handle = static_cast<PipelineHandle>(myEntries.size());
+    myHandles.emplace(std::move(key), handle);
+    ++myStats.myPipelineCount;
+
+    Entry& entry = myEntries.emplace_back();
+    entry.myPending = std::make_unique<PendingCompile>();
+    entry.myPending->myBuilder = builder;
+    entry.myPending->myRenderPass = pass;
+    myPendingHandles.push_back(handle);
+
+    // With no workers a queued job would only run once someone waits on it
+    if (blocking || JobSystem::GetThreadCount() <= 1)
+    {
+        Compile(*entry.myPending);
+        Update();
+        return handle;
+    }
+
+    PendingCompile* pending = entry.myPending.get();
+    JobSystem::Run(pending->myCounter, [this, pending]() { Compile(*pending); });
+    ++myStats.myBackgroundCompileCount;
+    return handle;
+}
+
+void PipelineRegistry::SetFallback(PipelineHandle handle)
+{
+    myFallback = handle;
+}
+
+void PipelineRegistry::Update()
+{
+    for (size_t i = 0; i < myPendingHandles.size();)
+    {
+        const PipelineHandle handle = myPendingHandles[i];
+        if (!myEntries[handle].myPending->myCounter.IsDone())
+        {
+            ++i;
+            continue;
+        }
+
+        FinishCompile(handle);
+        myPendingHandles[i] = myPendingHandles.back();
+        myPendingHandles.pop_back();
+    }
+}
+
+VkPipeline PipelineRegistry::GetPipeline(PipelineHandle handle) const
+{
+    if (handle < myEntries.size() && myEntries[handle].myPipeline)
+        return myEntries[handle].myPipeline;
+
+    return myFallback < myEntries.size() ? myEntries[myFallback].myPipeline : VK_NULL_HANDLE;
+}
+
+bool PipelineRegistry::IsReady(PipelineHandle handle) const
+{
+    return handle < myEntries.size() && myEntries[handle].myPipeline != VK_NULL_HANDLE;
+}
+
+void PipelineRegistry::Compile(PendingCompile& pending) const
+{
+    // vkCreateGraphicsPipelines and the pipeline cache are safe to use from any thread
+    const u64 start = PlatformLayer::GetTimeNanoseconds();
+    pending.myPipeline = pending.myBuilder.BuildPipeline(myDevice, pending.myRenderPass, myCache);
+    pending.myCompileTime = PlatformLayer::GetTimeNanoseconds() - start;
+}
+
+void PipelineRegistry::FinishCompile(PipelineHandle handle)
+{
+    Entry& entry = myEntries[handle];
+    const PendingCompile& pending = *entry.myPending;
+
+    entry.myPipeline = pending.myPipeline;
+    myStats.myCompileTime += pending.myCompileTime;
+    if (!entry.myPipeline)
+    {
+        // Stays on the fallback for good, asking again gives the same failed handle
+        entry.myIsFailed = true;
+        ++myStats.myFailedCount;
+        Logger::LogError("Pipeline {} failed to compile, drawing it with the fallback", handle);
+    }
+    else
+    {
+        Logger::Log("Pipeline {} compiled in {:.3f} ms", handle, pending.myCompileTime / 1000000.0);
+    }
+
+    entry.myPending.reset();
+}
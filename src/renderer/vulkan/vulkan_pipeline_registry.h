@@ -0,0 +1,111 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "odyssey/types.h"
+#include "odyssey/core/job_system.h"
+#include "vulkan_types.h"
+#include "vulkan_mesh.h"
+
+class PipelineBuilder
+{
+public:
+    std::vector<VkPipelineShaderStageCreateInfo> myShaderStages;
+    // Held by value and pointed to only while building, so a copied builder stays valid
+    VertexInputDescription myVertexInput;
+    VkPipelineInputAssemblyStateCreateInfo myInputAssembly;
+    VkViewport myViewport;
+    VkRect2D myScissor;
+    VkPipelineRasterizationStateCreateInfo myRasterizer;
+    VkPipelineColorBlendAttachmentState myColorBlendAttachment;
+    VkPipelineMultisampleStateCreateInfo myMultisampling;
+    VkPipelineLayout myPipelineLayout;
+    VkPipelineDepthStencilStateCreateInfo myDepthStencil;
+
+    VkPipeline BuildPipeline(VkDevice device, VkRenderPass pass, VkPipelineCache cache = VK_NULL_HANDLE) const;
+
+    // Every value that ends up in the pipeline with pointers followed, equal keys build equal pipelines.
+    // Shaders are compared by module handle.
+    std::string ComputeStateKey(VkRenderPass pass) const;
+};
+
+using PipelineHandle = u32;
+
+struct PipelineRegistryStats
+{
+    u32 myRequestCount{};
+    // Distinct pipelines, the rest of the requests were deduplicated
+    u32 myPipelineCount{};
+    u32 myBackgroundCompileCount{};
+    u32 myFailedCount{};
+    // Summed over every compile, on whichever thread it ran
+    u64 myCompileTime{};
+};
+
+// Every graphics pipeline goes through here. Requests are keyed by the builder's full state so
+// equal state always gives the same handle and compiles once. New state compiles on the job
+// system, and until it is done its handle resolves to the fallback pipeline, so a new material
+// shows up a few frames late instead of stalling the frame that asked for it.
+class PipelineRegistry
+{
+public:
+    static constexpr PipelineHandle INVALID_HANDLE = ~0u;
+
+    void Initialize(VkDevice device, VkPipelineCache cache);
+    // Waits for compiles still running, then destroys every pipeline and shader module
+    void Destroy();
+
+    // Takes over the module, background compiles may use it long after the caller is done
+    void AdoptShaderModule(VkShaderModule module);
+
+    // Compiles on the calling thread when blocking is set or there are no worker threads. A blocking
+    // request for a pipeline already compiling in the background waits for it, either way it is ready after.
+    PipelineHandle Request(const PipelineBuilder& builder, VkRenderPass pass, bool blocking = false);
+    // Drawn with in place of pipelines that aren't ready, has to be compatible with every layout and
+    // vertex input that is drawn with. Should be requested blocking.
+    void SetFallback(PipelineHandle handle);
+
+    // Picks up finished compiles, call once per frame from the thread that requests and draws
+    void Update();
+
+    // The pipeline when it is ready, the fallback otherwise. Only Update and Request change what
+    // it returns, so recording threads can call it in between.
+    VkPipeline GetPipeline(PipelineHandle handle) const;
+    bool IsReady(PipelineHandle handle) const;
+
+    const PipelineRegistryStats& GetStats() const { return myStats; }
+
+private:
+    struct PendingCompile
+    {
+        PipelineBuilder myBuilder{};
+        VkRenderPass myRenderPass{};
+        JobCounter myCounter{};
+        // Written by the job, read once myCounter is done
+        VkPipeline myPipeline{};
+        u64 myCompileTime{};
+    };
+
+    struct Entry
+    {
+        VkPipeline myPipeline{};
+        std::unique_ptr<PendingCompile> myPending{};
+        bool myIsFailed = false;
+    };
+
+    void Compile(PendingCompile& pending) const;
+    void FinishCompile(PipelineHandle handle);
+
+    VkDevice myDevice{};
+    VkPipelineCache myCache{};
+    PipelineHandle myFallback = INVALID_HANDLE;
+
+    std::unordered_map<std::string, PipelineHandle> myHandles{};
+    Vector<Entry> myEntries{};
+    Vector<PipelineHandle> myPendingHandles{};
+    Vector<VkShaderModule> myShaderModules{};
+
+    PipelineRegistryStats myStats{};
+};
@@ -0,0 +1,327 @@
+#include "vulkan_staging_uploader.h"
+
+#include "odyssey/core/assert.h"
+#include "vulkan_initializers.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Copies only need to be 4 byte aligned, 16 keeps the memcpys into the ring fast
+constexpr size_t STAGING_ALIGNMENT = 16;
+
+void StagingUploader::Initialize(VkDevice device, VmaAllocator allocator, VkQueue queue, uint32_t queueFamily, uint32_t ownerQueueFamily, size_t capacity)
+{
+    myDevice = device;
+    myAllocator = allocator;
+    myQueue = queue;
+    myQueueFamily = queueFamily;
+    myOwnerQueueFamily = ownerQueueFamily;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = capacity;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo allocationInfo{};
+    VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &myStagingBuffer.myBuffer, &myStagingBuffer.myAllocation, &allocationInfo));
+
+    myMappedData = static_cast<u8*>(allocationInfo.pMappedData);
+    myCapacity = capacity;
+    myHead = 0;
+    myUsedSize = 0;
+
+    const VkCommandPoolCreateInfo poolInfo = VulkanInit::CommandPoolCreateInfo(queueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &myCommandPool));
+
+    for (Batch& batch : myBatches)
+    {
+        const VkCommandBufferAllocateInfo commandBufferInfo = VulkanInit::CommandBufferAllocateBuffer(myCommandPool);
+        VK_CHECK(vkAllocateCommandBuffers(device, &commandBufferInfo, &batch.myCommandBuffer));
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &batch.myFence));
+    }
+}
+
+void StagingUploader::Destroy()
+{
+    if (!myDevice)
+        return;
+
+    Flush();
+
+    for (Batch& batch : myBatches)
+    {
+        vkDestroyFence(myDevice, batch.myFence, nullptr);
+        batch = {};
+    }
+
+    vkDestroyCommandPool(myDevice, myCommandPool, nullptr);
+    vmaDestroyBuffer(myAllocator, myStagingBuffer.myBuffer, myStagingBuffer.myAllocation);
+
+    myStagingBuffer = {};
+    myMappedData = nullptr;
+    myRangesToAcquire.clear();
+    myDevice = VK_NULL_HANDLE;
+}
+
+u64 StagingUploader::Upload(VkBuffer destination, VkDeviceSize destinationOffset, const void* data, size_t size)
+{
+    if (size == 0)
+        return 0;
+
+    const u8* source = static_cast<const u8*>(data);
+    const ReleasedRange range{ destination, destinationOffset, size };
+
+    // Half the ring at most so that one piece can be in flight while the next one is copied
+    const size_t maxPieceSize = std::max(myCapacity / 2, STAGING_ALIGNMENT) & ~(STAGING_ALIGNMENT - 1);
+
+    while (size > 0)
+    {
+        const size_t pieceSize = std::min(size, maxPieceSize);
+        // May submit the open batch to make room, so the batch to record into is looked up after
+        const size_t stagingOffset = AllocateStaging(pieceSize);
+        Batch& batch = GetOpenBatch();
+
+        memcpy(myMappedData + stagingOffset, source, pieceSize);
+
+        VkBufferCopy region{};
+        region.srcOffset = stagingOffset;
+        region.dstOffset = destinationOffset;
+        region.size = pieceSize;
+        vkCmdCopyBuffer(batch.myCommandBuffer, myStagingBuffer.myBuffer, destination, 1, &region);
+
+        myStats.myUploadedBytes += pieceSize;
+        ++myStats.myCopyCount;
+
+        source += pieceSize;
+        destinationOffset += pieceSize;
+        size -= pieceSize;
+    }
+
+    Batch& batch = myBatches[myOpenBatch];
+    if (IsTransferringOwnership())
+        batch.myReleasedRanges.push_back(range);
+
+    return batch.mySerial;
+}
+
+void StagingUploader::Submit()
+{
+    Batch& batch = myBatches[myOpenBatch];
+    if (!batch.myIsRecording)
+        return;
+
+    if (IsTransferringOwnership())
+    {
+        // Release half of the ownership transfer, the owner family acquires in AcquireUploads
+        Vector<VkBufferMemoryBarrier> releases(batch.myReleasedRanges.size());
+        for (size_t i = 0; i < releases.size(); ++i)
+        {
+            VkBufferMemoryBarrier& release = releases[i];
+            release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            release.srcQueueFamilyIndex = myQueueFamily;
+            release.dstQueueFamilyIndex = myOwnerQueueFamily;
+            release.buffer = batch.myReleasedRanges[i].myBuffer;
+            release.offset = batch.myReleasedRanges[i].myOffset;
+            release.size = batch.myReleasedRanges[i].mySize;
+        }
+
+        if (!releases.empty())
+            vkCmdPipelineBarrier(batch.myCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, static_cast<uint32_t>(releases.size()), releases.data(), 0, nullptr);
+    }
+    else
+    {
+        // Make the copies visible to everything submitted after this batch, whatever reads the buffers
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vkCmdPipelineBarrier(batch.myCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    VK_CHECK(vkEndCommandBuffer(batch.myCommandBuffer));
+
+    // Only does something on non coherent memory
+    vmaFlushAllocation(myAllocator, myStagingBuffer.myAllocation, 0, VK_WHOLE_SIZE);
+
+    VkSubmitInfo submit{};
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &batch.myCommandBuffer;
+    VK_CHECK(vkQueueSubmit(myQueue, 1, &submit, batch.myFence));
+
+    batch.myIsRecording = false;
+    batch.myIsPending = true;
+    ++myStats.mySubmitCount;
+
+    myOpenBatch = (myOpenBatch + 1) % BATCH_COUNT;
+}
+
+void StagingUploader::Flush()
+{
+    Submit();
+
+    // Oldest first, so the ring is handed back in order
+    for (u32 i = 0; i < BATCH_COUNT; ++i)
+        WaitForBatch(myBatches[(myOpenBatch + i) % BATCH_COUNT]);
+}
+
+void StagingUploader::AcquireUploads(VkCommandBuffer cmd)
+{
+    // Oldest first and stop at the first one still running, batches finish in submission order
+    u64 oldestUnfinishedSerial = myLastSerial + 1;
+    for (u32 i = 0; i < BATCH_COUNT; ++i)
+    {
+        Batch& batch = myBatches[(myOpenBatch + i) % BATCH_COUNT];
+        if (batch.myIsPending && vkGetFenceStatus(myDevice, batch.myFence) == VK_SUCCESS)
+            RetireBatch(batch);
+
+        if (batch.myIsPending || batch.myIsRecording)
+        {
+            oldestUnfinishedSerial = std::min(oldestUnfinishedSerial, batch.mySerial);
+            if (batch.myIsPending)
+                break;
+        }
+    }
+
+    if (!myRangesToAcquire.empty())
+    {
+        Vector<VkBufferMemoryBarrier> acquires(myRangesToAcquire.size());
+        for (size_t i = 0; i < acquires.size(); ++i)
+        {
+            VkBufferMemoryBarrier& acquire = acquires[i];
+            acquire.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            acquire.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            acquire.srcQueueFamilyIndex = myQueueFamily;
+            acquire.dstQueueFamilyIndex = myOwnerQueueFamily;
+            acquire.buffer = myRangesToAcquire[i].myBuffer;
+            acquire.offset = myRangesToAcquire[i].myOffset;
+            acquire.size = myRangesToAcquire[i].mySize;
+        }
+
+        // The host saw the release finish, so nothing on this side has to wait for it
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, static_cast<uint32_t>(acquires.size()), acquires.data(), 0, nullptr);
+        myRangesToAcquire.clear();
+    }
+
+    myAcquiredSerial = oldestUnfinishedSerial - 1;
+}
+
+bool StagingUploader::IsIdle() const
+{
+    for (const Batch& batch : myBatches)
+    {
+        if (batch.myIsPending || batch.myIsRecording)
+            return false;
+    }
+
+    return myRangesToAcquire.empty();
+}
+
+StagingUploader::Batch& StagingUploader::GetOpenBatch()
+{
+    Batch& batch = myBatches[myOpenBatch];
+    WaitForBatch(batch);
+
+    if (!batch.myIsRecording)
+    {
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK(vkBeginCommandBuffer(batch.myCommandBuffer, &beginInfo));
+
+        batch.mySerial = ++myLastSerial;
+        batch.myIsRecording = true;
+    }
+
+    return batch;
+}
+
+size_t StagingUploader::AllocateStaging(size_t size)
+{
+    ASSERT_MSG(size <= myCapacity, "Upload piece larger than the staging ring");
+
+    size_t offset = 0;
+    while (true)
+    {
+        // The open slot is reused round robin, its previous submit has to give its ring space back first
+        WaitForBatch(myBatches[myOpenBatch]);
+        if (TryAllocateStaging(size, offset))
+            return offset;
+
+        ++myStats.myStallCount;
+
+        // Free the oldest batch that holds ring space, which may be the open one
+        bool waited = false;
+        for (u32 i = 1; i <= BATCH_COUNT && !waited; ++i)
+        {
+            Batch& batch = myBatches[(myOpenBatch + i) % BATCH_COUNT];
+            if (batch.myIsPending)
+            {
+                WaitForBatch(batch);
+                waited = true;
+            }
+        }
+
+        if (!waited)
+        {
+            ASSERT_MSG(myBatches[myOpenBatch].myIsRecording, "Staging ring full with nothing in flight");
+            Submit();
+        }
+    }
+}
+
+bool StagingUploader::TryAllocateStaging(size_t size, size_t& outOffset)
+{
+    if (myUsedSize == 0)
+        myHead = 0;
+
+    size_t offset = (myHead + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+    size_t skipped = offset - myHead;
+
+    // Doesn't fit before the end, the rest of the ring is skipped and we continue at the start
+    if (offset + size > myCapacity)
+    {
+        skipped = myCapacity - myHead;
+        offset = 0;
+    }
+
+    if (myUsedSize + skipped + size > myCapacity)
+        return false;
+
+    myHead = offset + size;
+    myUsedSize += skipped + size;
+    myBatches[myOpenBatch].myRingSize += skipped + size;
+
+    outOffset = offset;
+    return true;
+}
+
+void StagingUploader::WaitForBatch(Batch& batch)
+{
+    if (!batch.myIsPending)
+        return;
+
+    VK_CHECK(vkWaitForFences(myDevice, 1, &batch.myFence, true, UINT64_MAX));
+    RetireBatch(batch);
+}
+
+void StagingUploader::RetireBatch(Batch& batch)
+{
+    VK_CHECK(vkResetFences(myDevice, 1, &batch.myFence));
+    VK_CHECK(vkResetCommandBuffer(batch.myCommandBuffer, 0));
+
+    myUsedSize -= batch.myRingSize;
+    batch.myRingSize = 0;
+    batch.myIsPending = false;
+
+    myRangesToAcquire.insert(myRangesToAcquire.end(), batch.myReleasedRanges.begin(), batch.myReleasedRanges.end());
+    batch.myReleasedRanges.clear();
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "odyssey/types.h"
+#include "vulkan_types.h"
+
+struct UploadStats
+{
+    u64 myUploadedBytes{};
+    u32 myCopyCount{};
+    u32 mySubmitCount{};
+    // Times an upload had to wait for the GPU to free up staging space
+    u32 myStallCount{};
+};
+
+// Streams data into device local buffers through one persistently mapped staging ring. Uploads are
+// copied into the ring and recorded as vkCmdCopyBuffer into the open batch, which goes out in a
+// single submit on Submit or Flush. Every batch is fenced and gives its part of the ring back once
+// the fence signals, so the ring is only ever waited on when it runs full.
+//
+// The uploader can run on another queue family than the one that uses the buffers, typically a
+// dedicated transfer queue. Each batch then releases the ranges it wrote to the owning family, and
+// AcquireUploads records the matching acquires once the batch is seen done on the host, so no
+// semaphores are needed and the owning queue never waits on the transfer queue. Only the written
+// ranges change hands, the rest of a shared buffer can be in use by the owner meanwhile.
+class StagingUploader
+{
+public:
+    static constexpr u32 BATCH_COUNT = 4;
+
+    // ownerQueueFamily is the family that uses the destination buffers, the same as queueFamily
+    // when uploading on the graphics queue
+    void Initialize(VkDevice device, VmaAllocator allocator, VkQueue queue, uint32_t queueFamily, uint32_t ownerQueueFamily, size_t capacity);
+    void Destroy();
+
+    // Data larger than the ring is split over several batches. Returns the serial of the batch the
+    // last piece went into, the data can be used once GetAcquiredSerial reaches it. The destination
+    // range is handed to the owner family with that batch.
+    u64 Upload(VkBuffer destination, VkDeviceSize destinationOffset, const void* data, size_t size);
+
+    // Submits the open batch without waiting for it
+    void Submit();
+    // Submits the open batch and waits until every upload so far has landed
+    void Flush();
+
+    // Retires finished batches without blocking and records the ownership acquires for their ranges
+    // into cmd, which has to run on the owner family before anything reads them. Outside render passes.
+    void AcquireUploads(VkCommandBuffer cmd);
+    // Every upload with a serial up to this one is visible to commands recorded after AcquireUploads
+    u64 GetAcquiredSerial() const { return myAcquiredSerial; }
+    bool IsIdle() const;
+
+    bool IsTransferringOwnership() const { return myQueueFamily != myOwnerQueueFamily; }
+    const UploadStats& GetStats() const { return myStats; }
+    size_t GetCapacity() const { return myCapacity; }
+
+private:
+    struct ReleasedRange
+    {
+        VkBuffer myBuffer{};
+        VkDeviceSize myOffset{};
+        VkDeviceSize mySize{};
+    };
+
+    struct Batch
+    {
+        VkCommandBuffer myCommandBuffer{};
+        VkFence myFence{};
+        // Ring bytes this batch holds on to, including what was skipped when wrapping
+        size_t myRingSize{};
+        // Ranges this batch hands to the owner family when it is submitted
+        Vector<ReleasedRange> myReleasedRanges;
+        u64 mySerial{};
+        bool myIsRecording = false;
+        bool myIsPending = false;
+    };
+
+    Batch& GetOpenBatch();
+    // Returns the ring offset of size free bytes, waits for older batches when needed
+    size_t AllocateStaging(size_t size);
+    bool TryAllocateStaging(size_t size, size_t& outOffset);
+    void WaitForBatch(Batch& batch);
+    void RetireBatch(Batch& batch);
+
+    VkDevice myDevice{};
+    VmaAllocator myAllocator{};
+    VkQueue myQueue{};
+    uint32_t myQueueFamily{};
+    uint32_t myOwnerQueueFamily{};
+    VkCommandPool myCommandPool{};
+
+    AllocatedBuffer myStagingBuffer{};
+    u8* myMappedData{};
+    size_t myCapacity{};
+    size_t myHead{};
+    size_t myUsedSize{};
+
+    Batch myBatches[BATCH_COUNT];
+    // The batch being recorded, older ones follow it in submission order
+    u32 myOpenBatch{};
+    u64 myLastSerial{};
+    u64 myAcquiredSerial{};
+    // Released by retired batches, acquired on the next AcquireUploads
+    Vector<ReleasedRange> myRangesToAcquire;
+
+    UploadStats myStats{};
+};
@@ -0,0 +1,67 @@
+#include "vulkan_transient_allocator.h"
+
+#include "odyssey/core/assert.h"
+
+#include <algorithm>
+
+void TransientAllocator::Initialize(VmaAllocator allocator, size_t capacity, size_t alignment, VkBufferUsageFlags usage)
+{
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = capacity;
+    bufferInfo.usage = usage;
+
+    VmaAllocationCreateInfo allocInfo{};
+    allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo allocationInfo{};
+    VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &myBuffer.myBuffer, &myBuffer.myAllocation, &allocationInfo));
+
+    myMappedData = static_cast<u8*>(allocationInfo.pMappedData);
+    myCapacity = capacity;
+    myAlignment = std::max<size_t>(alignment, 1);
+    myOffset = 0;
+    myPeakOffset = 0;
+}
+
+void TransientAllocator::Destroy(VmaAllocator allocator)
+{
+    if (myBuffer.myBuffer)
+        vmaDestroyBuffer(allocator, myBuffer.myBuffer, myBuffer.myAllocation);
+
+    myBuffer = {};
+    myMappedData = nullptr;
+    myCapacity = 0;
+}
+
+void TransientAllocator::Reset()
+{
+    myOffset = 0;
+}
+
+TransientAllocation TransientAllocator::Allocate(size_t size)
+{
+    // Alignment comes from the device limits and is always a power of two
+    const size_t offset = (myOffset + myAlignment - 1) & ~(myAlignment - 1);
+    if (offset + size > myCapacity)
+    {
+        ASSERT_MSG(false, "Transient allocator out of memory");
+        return {};
+    }
+
+    myOffset = offset + size;
+    myPeakOffset = std::max(myPeakOffset, myOffset);
+
+    TransientAllocation allocation{};
+    allocation.myData = myMappedData + offset;
+    allocation.myBuffer = myBuffer.myBuffer;
+    allocation.myOffset = static_cast<uint32_t>(offset);
+    return allocation;
+}
+
+void TransientAllocator::Flush(VmaAllocator allocator) const
+{
+    if (myOffset > 0)
+        vmaFlushAllocation(allocator, myBuffer.myAllocation, 0, myOffset);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "odyssey/types.h"
+#include "vulkan_types.h"
+
+struct TransientAllocation
+{
+    void* myData{};
+    VkBuffer myBuffer{};
+    uint32_t myOffset{};
+};
+
+// Linear allocator over one persistently mapped buffer, meant to be owned per frame in flight.
+// Everything allocated from it is valid until Reset, which may only be called once the GPU
+// is done with the frame. Allocations are bound with dynamic offsets so there is no map
+// call and no descriptor update per allocation.
+class TransientAllocator
+{
+public:
+    void Initialize(VmaAllocator allocator, size_t capacity, size_t alignment, VkBufferUsageFlags usage);
+    void Destroy(VmaAllocator allocator);
+
+    void Reset();
+    TransientAllocation Allocate(size_t size);
+
+    template <typename T>
+    T* Allocate(uint32_t& outOffset)
+    {
+        const TransientAllocation allocation = Allocate(sizeof(T));
+        outOffset = allocation.myOffset;
+        return static_cast<T*>(allocation.myData);
+    }
+
+    // Makes the writes visible to the GPU, only does something on non coherent memory
+    void Flush(VmaAllocator allocator) const;
+
+    VkBuffer GetBuffer() const { return myBuffer.myBuffer; }
+    size_t GetCapacity() const { return myCapacity; }
+    size_t GetUsedSize() const { return myOffset; }
+    size_t GetPeakUsedSize() const { return myPeakOffset; }
+
+private:
+    AllocatedBuffer myBuffer{};
+    u8* myMappedData{};
+    size_t myCapacity{};
+    size_t myAlignment = 1;
+    size_t myOffset{};
+    size_t myPeakOffset{};
+};
@@ -0,0 +1,42 @@
+#include "odyssey/core/logger.h"
+#include "renderer/cooked_mesh.h"
+#include "renderer/vulkan/vulkan_mesh.h"
+
+#include <cstring>
+
+// Converts an OBJ into the cooked binary mesh the renderer loads at runtime, see cooked_mesh.h.
+// Usage: mesh_cooker [--packed] <input.obj> <output.mesh>
+
+int main(int argc, char* argv[])
+{
+	Logger::Initialize();
+
+	bool isPacked = false;
+	Vector<const char*> paths;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--packed") == 0)
+			isPacked = true;
+		else
+			paths.push_back(argv[i]);
+	}
+
+	if (paths.size() != 2)
+	{
+		Logger::LogError("Usage: mesh_cooker [--packed] <input.obj> <output{}>", CookedMesh::EXTENSION);
+		return 1;
+	}
+
+	Mesh mesh{};
+	if (!mesh.LoadFromObj(paths[0]))
+		return 1;
+
+	if (isPacked)
+		mesh.Pack();
+
+	if (!mesh.SaveCooked(paths[1]))
+		return 1;
+
+	Logger::Log("Cooked {} into {} ({} vertex bytes, {} index bytes)", paths[0], paths[1], mesh.GetVertexDataSize(), mesh.GetIndexDataSize());
+	return 0;
+}
@@ -0,0 +1,42 @@
+#include "odyssey/core/logger.h"
+#include "renderer/vulkan/vulkan_mesh.h"
+
+// Packs every OBJ given on the command line into the quantized vertex format and reports
+// how far the packed vertices are from the originals, usage: mesh_packing_error a.obj b.obj ...
+
+int main(int argc, char* argv[])
+{
+	Logger::Initialize();
+
+	if (argc < 2)
+	{
+		Logger::LogError("Usage: mesh_packing_error <mesh.obj>...");
+		return 1;
+	}
+
+	bool success = true;
+	for (int i = 1; i < argc; ++i)
+	{
+		Mesh mesh{};
+		if (!mesh.LoadFromObj(argv[i]))
+		{
+			success = false;
+			continue;
+		}
+
+		const size_t fullSize = mesh.GetVertexDataSize();
+		mesh.Pack();
+		const size_t packedSize = mesh.GetVertexDataSize();
+
+		const VertexPackingError error = mesh.MeasurePackingError();
+		const float diagonal = glm::length(mesh.myBounds.myMax - mesh.myBounds.myMin);
+
+		Logger::Log("{}: {} vertices, {} -> {} bytes", argv[i], mesh.myVertices.size(), fullSize, packedSize);
+		Logger::Log("  position error max {:.6f} avg {:.6f} ({:.5f}% of the bounds diagonal)",
+			error.myMaxPositionError, error.myAveragePositionError, diagonal > 0.0f ? 100.0f * error.myMaxPositionError / diagonal : 0.0f);
+		Logger::Log("  normal error max {:.4f} avg {:.4f} degrees", error.myMaxNormalError, error.myAverageNormalError);
+		Logger::Log("  color error max {:.4f}", error.myMaxColorError);
+	}
+
+	return success ? 0 : 1;
+}